@@ -0,0 +1,84 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// A tiny benchmark harness, every benchmark reports one JSON object per line
+// so the output can be collected and compared between releases
+namespace bench
+{
+    using t_clock = std::chrono::steady_clock;
+
+    template <typename t_value>
+    inline void do_not_optimize(const t_value& value)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "r,m"(value) : "memory");
+#else
+        static volatile const void* sink;
+        sink = &value;
+#endif
+    }
+
+    class state
+    {
+        std::string m_name;
+        std::vector<std::pair<std::string, double>> m_counters;
+
+    public:
+        explicit state(std::string name) : m_name(std::move(name)) {}
+
+        // Runs body(idx) for every idx in [0, iterations) and reports the average
+        // cost of one iteration
+        template <typename t_body>
+        void measure(const std::string& label, size_t iterations, t_body&& body)
+        {
+            const auto started = t_clock::now();
+            for (size_t idx = 0; idx < iterations; ++idx) body(idx);
+            const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                t_clock::now() - started);
+            report(label, iterations, static_cast<double>(elapsed.count()));
+        }
+
+        void counter(const std::string& name, double value)
+        {
+            m_counters.emplace_back(name, value);
+        }
+
+        void report(const std::string& label, size_t iterations, double total_ns)
+        {
+            std::cout << "{\"benchmark\": \"" << m_name << "/" << label
+                      << "\", \"iterations\": " << iterations << ", \"ns_per_op\": "
+                      << (iterations ? total_ns / iterations : 0.0);
+            for (const auto& [name, value] : m_counters) {
+                std::cout << ", \"" << name << "\": " << value;
+            }
+            std::cout << "}" << std::endl;
+            m_counters.clear();
+        }
+    };
+
+    using t_benchmark = std::function<void(state&)>;
+
+    inline std::vector<std::pair<std::string, t_benchmark>>& registry()
+    {
+        static std::vector<std::pair<std::string, t_benchmark>> benchmarks;
+        return benchmarks;
+    }
+
+    struct registrar
+    {
+        registrar(const char* name, t_benchmark benchmark)
+        {
+            registry().emplace_back(name, std::move(benchmark));
+        }
+    };
+}  // namespace bench
+
+#define FACADE_BENCHMARK(_NAME)                                              \
+    static void bench_##_NAME(::bench::state& state);                        \
+    static ::bench::registrar bench_registrar_##_NAME{#_NAME, bench_##_NAME}; \
+    static void bench_##_NAME(::bench::state& state)
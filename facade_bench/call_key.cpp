@@ -0,0 +1,87 @@
+#include "bench.h"
+
+#include <string>
+
+#include <facade.h>
+
+namespace
+{
+    constexpr size_t iterations = 5'000'000;
+
+    class calculator
+    {
+    public:
+        int add(int lhv, int rhv) const { return lhv + rhv; }
+        int length(const std::string& text) const { return static_cast<int>(text.size()); }
+        int zero() const { return 0; }
+    };
+
+    class call_key_calculator_facade : public facade::facade<calculator>
+    {
+    public:
+        FACADE_CONSTRUCTOR(call_key_calculator_facade);
+        FACADE_METHOD(add);
+        FACADE_METHOD(length);
+        FACADE_METHOD(zero);
+    };
+
+    // how a replayed call found its key before: serialize the arguments, hash the text
+    template <typename t_archive_policy, typename... t_args>
+    uint64_t serialized_key(const t_args&... args)
+    {
+        std::string recorded;
+        facade::record_args<t_archive_policy>(recorded, args...);
+        return facade::utils::hash64(recorded);
+    }
+}  // namespace
+
+FACADE_BENCHMARK(call_key)
+{
+    const std::string text{"a short string argument"};
+
+    state.measure("json_two_ints", iterations, [&](size_t idx) {
+        bench::do_not_optimize(
+            serialized_key<facade::json_archive_policy>(static_cast<int>(idx), 1));
+    });
+    state.measure("binary_two_ints", iterations, [&](size_t idx) {
+        bench::do_not_optimize(
+            serialized_key<facade::binary_archive_policy>(static_cast<int>(idx), 1));
+    });
+    state.measure("value_two_ints", iterations, [&](size_t idx) {
+        bench::do_not_optimize(facade::calculate_key(static_cast<int>(idx), 1));
+    });
+
+    state.measure("json_string", iterations, [&](size_t) {
+        bench::do_not_optimize(serialized_key<facade::json_archive_policy>(text));
+    });
+    state.measure("value_string", iterations, [&](size_t) {
+        bench::do_not_optimize(facade::calculate_key(text));
+    });
+
+    // whole replayed calls, without the recorded durations
+    {
+        facade::master().start_recording();
+        call_key_calculator_facade recorded{std::make_unique<calculator>()};
+        recorded.add(1, 2);
+        recorded.length(text);
+        recorded.zero();
+        facade::master().stop();
+    }
+    const double time_factor = facade::master().get_replay_time_factor();
+    facade::master().set_replay_time_factor(0.0);
+    facade::master().start_playing();
+    {
+        call_key_calculator_facade replayed;
+        state.measure("replay_two_ints", iterations, [&](size_t) {
+            bench::do_not_optimize(replayed.add(1, 2));
+        });
+        state.measure("replay_string", iterations, [&](size_t) {
+            bench::do_not_optimize(replayed.length(text));
+        });
+        state.measure("replay_no_args", iterations, [&](size_t) {
+            bench::do_not_optimize(replayed.zero());
+        });
+    }
+    facade::master().stop();
+    facade::master().set_replay_time_factor(time_factor);
+}
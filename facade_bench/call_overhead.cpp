@@ -0,0 +1,210 @@
+#include "bench.h"
+
+#include <functional>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include <facade.h>
+
+namespace
+{
+    // calls that take little memory each and calls with large payloads, recording
+    // keeps every call in memory until it's stopped
+    struct iterations
+    {
+        size_t small;
+        size_t large;
+    };
+
+    constexpr iterations passthrough_iterations{10'000'000, 1'000'000};
+    constexpr iterations recording_iterations{200'000, 5'000};
+    constexpr iterations replay_iterations{1'000'000, 100'000};
+
+    using t_ready_cbk = std::function<void(int)>;
+
+    class workload
+    {
+        t_ready_cbk m_ready_cbk;
+
+    public:
+        int ping() const { return 1; }
+        int add(int lhv, int rhv) const { return lhv + rhv; }
+        size_t length(const std::string& text) const { return text.size(); }
+        int64_t sum(const std::vector<int>& values) const
+        {
+            return std::accumulate(values.begin(), values.end(), int64_t{0});
+        }
+        bool describe(int value, std::string& description) const
+        {
+            description = "value " + std::to_string(value);
+            return true;
+        }
+        static int twice(int value) { return value * 2; }
+
+        void register_ready_cbk(t_ready_cbk cbk) { m_ready_cbk = std::move(cbk); }
+    };
+
+    class json_workload_facade : public facade::facade<workload>
+    {
+    public:
+        FACADE_CONSTRUCTOR(json_workload_facade);
+        FACADE_METHOD(ping);
+        FACADE_METHOD(add);
+        FACADE_METHOD(length);
+        FACADE_METHOD(sum);
+        FACADE_METHOD(describe);
+        FACADE_CALLBACK(ready_cbk, void, int);
+    };
+
+    class binary_workload_facade
+        : public facade::facade<workload, facade::binary_archive_policy>
+    {
+    public:
+        FACADE_CONSTRUCTOR(binary_workload_facade);
+        FACADE_METHOD(ping);
+        FACADE_METHOD(add);
+        FACADE_METHOD(length);
+        FACADE_METHOD(sum);
+        FACADE_METHOD(describe);
+        FACADE_CALLBACK(ready_cbk, void, int);
+    };
+
+    class static_workload_facade : public facade::facade<workload>
+    {
+    public:
+        FACADE_SINGLETON_CONSTRUCTOR(static_workload_facade);
+        FACADE_STATIC_METHOD(twice);
+    };
+
+    // the arguments are the same in every mode, so replay finds the recorded calls
+    struct arguments
+    {
+        std::string large_text = std::string(4096, 'x');
+        std::vector<int> large_vector = std::vector<int>(1024, 7);
+    };
+
+    // runs every argument shape against the workload itself or a facade of it
+    template <typename t_target>
+    void measure_shapes(bench::state& state, const std::string& mode, t_target& target,
+        const iterations& counts)
+    {
+        const arguments args;
+        state.measure(mode + "/no_args", counts.small, [&](size_t) {
+            bench::do_not_optimize(target.ping());
+        });
+        state.measure(mode + "/two_ints", counts.small, [&](size_t) {
+            bench::do_not_optimize(target.add(20, 22));
+        });
+        state.measure(mode + "/out_parameter", counts.small, [&](size_t) {
+            std::string description;
+            bench::do_not_optimize(target.describe(42, description));
+            bench::do_not_optimize(description.size());
+        });
+        state.counter("bytes", static_cast<double>(args.large_text.size()));
+        state.measure(mode + "/large_string", counts.large, [&](size_t) {
+            bench::do_not_optimize(target.length(args.large_text));
+        });
+        state.counter("elements", static_cast<double>(args.large_vector.size()));
+        state.measure(mode + "/large_vector", counts.large, [&](size_t) {
+            bench::do_not_optimize(target.sum(args.large_vector));
+        });
+    }
+
+    template <typename t_static_target>
+    void measure_static(
+        bench::state& state, const std::string& mode, const iterations& counts)
+    {
+        state.measure(mode + "/static", counts.small, [&](size_t) {
+            bench::do_not_optimize(t_static_target::twice(21));
+        });
+    }
+
+    template <typename t_facade>
+    void measure_facade_modes(bench::state& state, const std::string& policy)
+    {
+        {
+            t_facade facade{std::make_unique<workload>()};
+            const auto mode = "passthrough_" + policy;
+            measure_shapes(state, mode, facade, passthrough_iterations);
+        }
+
+        facade::master().start_recording();
+        {
+            t_facade facade{std::make_unique<workload>()};
+            const auto mode = "recording_" + policy;
+            measure_shapes(state, mode, facade, recording_iterations);
+        }
+        facade::master().stop();
+
+        const double time_factor = facade::master().get_replay_time_factor();
+        facade::master().set_replay_time_factor(0.0);
+        facade::master().start_playing();
+        {
+            t_facade facade;
+            measure_shapes(state, "replay_" + policy, facade, replay_iterations);
+        }
+        facade::master().stop();
+        facade::master().set_replay_time_factor(time_factor);
+    }
+
+    template <typename t_facade>
+    void measure_callback(bench::state& state, const std::string& mode, size_t count)
+    {
+        t_facade facade{std::make_unique<workload>()};
+        int received = 0;
+        facade.register_callback_ready_cbk([&received](int value) { received += value; });
+        const auto trampoline = facade.get_callback_ready_cbk();
+        state.measure(
+            mode, count, [&](size_t idx) { trampoline(static_cast<int>(idx)); });
+        bench::do_not_optimize(received);
+    }
+}  // namespace
+
+// Cost of one call by the way it's made, each label is <mode>/<argument shape>.
+// direct calls are the baseline the facade overhead is measured against
+FACADE_BENCHMARK(call_overhead)
+{
+    workload direct;
+    measure_shapes(state, "direct", direct, passthrough_iterations);
+    measure_static<workload>(state, "direct", passthrough_iterations);
+    measure_static<static_workload_facade>(state, "passthrough", passthrough_iterations);
+
+    measure_facade_modes<json_workload_facade>(state, "json");
+    measure_facade_modes<binary_workload_facade>(state, "binary");
+
+    // a singleton facade is only saved and loaded while it's registered
+    auto& singleton = static_workload_facade::get_facade_instance();
+    singleton.register_facade();
+    facade::master().start_recording();
+    measure_static<static_workload_facade>(state, "recording", recording_iterations);
+    facade::master().stop();
+    singleton.unregister_facade();
+
+    const double time_factor = facade::master().get_replay_time_factor();
+    facade::master().set_replay_time_factor(0.0);
+    facade::master().start_playing();
+    singleton.register_facade();
+    measure_static<static_workload_facade>(state, "replay", replay_iterations);
+    facade::master().stop();
+    singleton.unregister_facade();
+    facade::master().set_replay_time_factor(time_factor);
+}
+
+// callbacks go through a trampoline handed to the implementation, they are
+// replayed by the player thread and have no per call replay cost to measure
+FACADE_BENCHMARK(callback_overhead)
+{
+    t_ready_cbk direct = [received = 0](int value) mutable { received += value; };
+    state.measure("direct", passthrough_iterations.small,
+        [&](size_t idx) { direct(static_cast<int>(idx)); });
+
+    measure_callback<json_workload_facade>(
+        state, "passthrough", passthrough_iterations.small);
+    facade::master().start_recording();
+    measure_callback<json_workload_facade>(
+        state, "recording_json", recording_iterations.small);
+    measure_callback<binary_workload_facade>(
+        state, "recording_binary", recording_iterations.small);
+    facade::master().stop();
+}
@@ -0,0 +1,84 @@
+#include "bench.h"
+
+#include <sstream>
+#include <string>
+
+#include <facade.h>
+
+namespace
+{
+    constexpr size_t iterations = 20;
+
+    class thermometer
+    {
+        int m_reads{0};
+
+    public:
+        double read(int sensor) { return 20.0 + sensor + (++m_reads % 16) * 0.25; }
+        std::string describe(int sensor) const
+        {
+            return "sensor " + std::to_string(sensor) + " in the server room";
+        }
+    };
+
+    class compression_json_facade : public facade::facade<thermometer>
+    {
+    public:
+        FACADE_CONSTRUCTOR(compression_json_facade);
+        FACADE_METHOD(read);
+        FACADE_METHOD(describe);
+    };
+
+    class compression_binary_facade
+        : public facade::facade<thermometer, facade::binary_archive_policy>
+    {
+    public:
+        FACADE_CONSTRUCTOR(compression_binary_facade);
+        FACADE_METHOD(read);
+        FACADE_METHOD(describe);
+    };
+
+    template <typename t_facade>
+    std::string make_recording()
+    {
+        std::ostringstream stream;
+        facade::master().set_get_facade_stream_callback(
+            [&stream](const std::string&) -> std::ostream* { return &stream; });
+        facade::master().start_recording();
+        {
+            t_facade recorded{std::make_unique<thermometer>()};
+            for (int idx = 0; idx < 20000; ++idx) {
+                recorded.read(idx % 8);
+                recorded.describe(idx % 8);
+            }
+        }
+        facade::master().stop();
+        facade::master().set_get_facade_stream_callback(nullptr);
+        return stream.str();
+    }
+
+    void measure_codec(bench::state& state, const std::string& label,
+        const std::string& recording)
+    {
+        const double megabytes = static_cast<double>(recording.size()) / (1024 * 1024);
+        std::string compressed;
+        state.measure(label + "_compress", iterations, [&](size_t) {
+            std::ostringstream stream;
+            facade::recording_format::write_compressed(stream, recording, 256 * 1024);
+            compressed = stream.str();
+        });
+        const facade::recording_format::compressed_view view{
+            compressed.data(), compressed.size()};
+        state.counter("raw_bytes", static_cast<double>(recording.size()));
+        state.counter("compressed_bytes", static_cast<double>(compressed.size()));
+        state.counter("raw_mb", megabytes);
+        state.measure(label + "_decompress", iterations,
+            [&](size_t) { bench::do_not_optimize(view.decompress()); });
+    }
+}  // namespace
+
+FACADE_BENCHMARK(compression)
+{
+    measure_codec(state, "json", make_recording<compression_json_facade>());
+    measure_codec(state, "binary", make_recording<compression_binary_facade>());
+}
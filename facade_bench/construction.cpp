@@ -0,0 +1,79 @@
+#include "bench.h"
+
+#include <string>
+
+#include <facade.h>
+
+namespace
+{
+    // distinct calls in the recordings the facades are constructed from
+    constexpr int recorded_calls = 20'000;
+    constexpr size_t loaded_constructions = 20;
+    constexpr size_t cached_constructions = 200'000;
+
+    class squares
+    {
+    public:
+        int square(int value) const { return value * value; }
+    };
+
+    class construction_json_facade : public facade::facade<squares>
+    {
+    public:
+        FACADE_CONSTRUCTOR(construction_json_facade);
+        FACADE_METHOD(square);
+    };
+
+    class construction_binary_facade
+        : public facade::facade<squares, facade::binary_archive_policy>
+    {
+    public:
+        FACADE_CONSTRUCTOR(construction_binary_facade);
+        FACADE_METHOD(square);
+    };
+
+    template <typename t_facade>
+    void measure_construction(bench::state& state, const std::string& format)
+    {
+        facade::master().start_recording();
+        {
+            t_facade recorded{std::make_unique<squares>()};
+            for (int value = 0; value < recorded_calls; ++value) recorded.square(value);
+        }
+        facade::master().stop();
+
+        facade::master().start_playing();
+        state.counter("recorded_calls", recorded_calls);
+        // every facade loads the recording, as if it wasn't cached
+        state.measure(format + "/loaded", loaded_constructions, [](size_t) {
+            facade::master().clear_recording_snapshots();
+            t_facade replayed;
+            bench::do_not_optimize(replayed.square(7));
+        });
+        state.counter("recorded_calls", recorded_calls);
+        state.measure(format + "/cached", cached_constructions, [](size_t) {
+            t_facade replayed;
+            bench::do_not_optimize(replayed.square(7));
+        });
+        facade::master().stop();
+        facade::master().clear_recording_snapshots();
+
+        // what constructing the facade costs without a recording
+        state.measure(format + "/passthrough", cached_constructions, [](size_t) {
+            t_facade passed_through;
+            bench::do_not_optimize(&passed_through);
+        });
+    }
+}  // namespace
+
+// Constructing a short lived facade in playing mode and replaying one call, from a
+// recording loaded for it and from the snapshot cached by the previous facades.
+// The cached construction doesn't depend on the size of the recording
+FACADE_BENCHMARK(facade_construction)
+{
+    const double time_factor = facade::master().get_replay_time_factor();
+    facade::master().set_replay_time_factor(0.0);
+    measure_construction<construction_json_facade>(state, "json");
+    measure_construction<construction_binary_facade>(state, "binary");
+    facade::master().set_replay_time_factor(time_factor);
+}
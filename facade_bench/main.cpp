@@ -0,0 +1,14 @@
+#include "bench.h"
+
+// Usage: facade_bench [name filter]
+// Runs every registered benchmark whose name contains the filter
+int main(int argc, char** argv)
+{
+    const std::string filter = argc > 1 ? argv[1] : "";
+    for (const auto& [name, benchmark] : bench::registry()) {
+        if (name.find(filter) == std::string::npos) continue;
+        bench::state state{name};
+        benchmark(state);
+    }
+    return 0;
+}
@@ -0,0 +1,61 @@
+#include "bench.h"
+
+#include <facade.h>
+
+namespace
+{
+    constexpr size_t iterations = 50'000'000;
+
+    class calculator
+    {
+        std::string m_name{"calculator"};
+
+    public:
+        int add(int lhv, int rhv) const { return lhv + rhv; }
+        const std::string& name() const { return m_name; }
+        static int twice(int value) { return value * 2; }
+    };
+
+    class calculator_facade : public facade::facade<calculator>
+    {
+    public:
+        FACADE_CONSTRUCTOR(calculator_facade);
+        FACADE_METHOD(add);
+        FACADE_METHOD(name);
+    };
+
+    class static_calculator_facade : public facade::facade<calculator>
+    {
+    public:
+        FACADE_SINGLETON_CONSTRUCTOR(static_calculator_facade);
+        FACADE_STATIC_METHOD(twice);
+    };
+}  // namespace
+
+FACADE_BENCHMARK(passthrough)
+{
+    calculator direct;
+    calculator_facade wrapped{std::make_unique<calculator>()};
+
+    state.measure("direct_add", iterations, [&](size_t idx) {
+        bench::do_not_optimize(direct.add(static_cast<int>(idx), 1));
+    });
+    state.measure("facade_add", iterations, [&](size_t idx) {
+        bench::do_not_optimize(wrapped.add(static_cast<int>(idx), 1));
+    });
+
+    state.measure("direct_static", iterations, [&](size_t idx) {
+        bench::do_not_optimize(calculator::twice(static_cast<int>(idx)));
+    });
+    state.measure("facade_static", iterations, [&](size_t idx) {
+        bench::do_not_optimize(static_calculator_facade::twice(static_cast<int>(idx)));
+    });
+
+    // a getter returning a reference, the facade returns a copy
+    state.measure("direct_name", iterations, [&](size_t) {
+        bench::do_not_optimize(std::string{direct.name()});
+    });
+    state.measure("facade_name", iterations, [&](size_t) {
+        bench::do_not_optimize(wrapped.name());
+    });
+}
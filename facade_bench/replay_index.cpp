@@ -0,0 +1,94 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <string>
+#include <unordered_map>
+
+#include <flat_map.h>
+#include <hash.h>
+
+namespace
+{
+    size_t keys_number()
+    {
+        if (const char* keys = std::getenv("FACADE_BENCH_KEYS")) {
+            return static_cast<size_t>(std::strtoull(keys, nullptr, 10));
+        }
+        return 10'000'000;
+    }
+
+    // Stand-in for the serialized pre-call arguments of a call
+    struct payload
+    {
+        char bytes[32];
+
+        explicit payload(size_t idx)
+        {
+            std::memset(bytes, 'a', sizeof(bytes));
+            std::memcpy(bytes, &idx, sizeof(idx));
+        }
+
+        uint64_t fingerprint() const { return facade::utils::hash64(bytes, sizeof(bytes)); }
+    };
+
+    std::string to_hex(uint64_t fingerprint)
+    {
+        char hex[33];
+        std::snprintf(hex, sizeof(hex), "%016llx%016llx",
+            static_cast<unsigned long long>(fingerprint),
+            static_cast<unsigned long long>(~fingerprint));
+        return hex;
+    }
+
+    std::vector<uint32_t> shuffled_indices(size_t keys)
+    {
+        std::vector<uint32_t> indices(keys);
+        std::iota(indices.begin(), indices.end(), 0);
+        std::shuffle(indices.begin(), indices.end(), std::mt19937_64{42});
+        return indices;
+    }
+}  // namespace
+
+FACADE_BENCHMARK(replay_index)
+{
+    const size_t keys = keys_number();
+    const auto indices = shuffled_indices(keys);
+
+    state.measure("fingerprint_32_bytes", keys, [&](size_t idx) {
+        bench::do_not_optimize(payload{indices[idx]}.fingerprint());
+    });
+
+    {
+        facade::utils::flat_map<uint64_t, uint32_t> index;
+        index.reserve(keys);
+        for (size_t idx = 0; idx < keys; ++idx) {
+            index.try_emplace(payload{idx}.fingerprint(), static_cast<uint32_t>(idx));
+        }
+
+        state.counter("keys", static_cast<double>(keys));
+        state.measure("flat_map_lookup", keys, [&](size_t idx) {
+            bench::do_not_optimize(index.find(payload{indices[idx]}.fingerprint()));
+        });
+    }
+
+    {
+        // what every replayed call paid before: a hex string key built per call and
+        // a lookup in a node based map, the MD5 itself is not included
+        std::unordered_map<std::string, uint32_t> index;
+        index.reserve(keys);
+        for (size_t idx = 0; idx < keys; ++idx) {
+            index.emplace(to_hex(payload{idx}.fingerprint()), static_cast<uint32_t>(idx));
+        }
+
+        state.counter("keys", static_cast<double>(keys));
+        state.measure("hex_string_unordered_map_lookup", keys, [&](size_t idx) {
+            const auto found = index.find(to_hex(payload{indices[idx]}.fingerprint()));
+            bench::do_not_optimize(found->second);
+        });
+    }
+}
@@ -0,0 +1,60 @@
+#include "bench.h"
+
+#include <string>
+#include <vector>
+
+#include <facade.h>
+
+namespace
+{
+    constexpr size_t iterations = 2'000'000;
+
+    class network
+    {
+    public:
+        std::string get_local_ip() const { return "192.168.100.200"; }
+        bool get_routes(std::vector<std::string>& routes) const
+        {
+            routes = {"10.0.0.0/8", "172.16.0.0/12", "192.168.0.0/16"};
+            return true;
+        }
+    };
+
+    class replay_results_network_facade : public facade::facade<network>
+    {
+    public:
+        FACADE_CONSTRUCTOR(replay_results_network_facade);
+        FACADE_METHOD(get_local_ip);
+        FACADE_METHOD(get_routes);
+    };
+}  // namespace
+
+// replays of the same recorded results, as result_selection::cycle does
+FACADE_BENCHMARK(replay_results)
+{
+    {
+        facade::master().start_recording();
+        replay_results_network_facade recorded{std::make_unique<network>()};
+        recorded.get_local_ip();
+        std::vector<std::string> routes;
+        recorded.get_routes(routes);
+        facade::master().stop();
+    }
+    const double time_factor = facade::master().get_replay_time_factor();
+    facade::master().set_replay_time_factor(0.0);
+    facade::master().start_playing();
+    {
+        replay_results_network_facade replayed;
+        state.measure("string_result", iterations, [&](size_t) {
+            bench::do_not_optimize(replayed.get_local_ip());
+        });
+        state.measure("out_parameter", iterations, [&](size_t) {
+            // the recorded call was made with an empty vector
+            std::vector<std::string> routes;
+            bench::do_not_optimize(replayed.get_routes(routes));
+            bench::do_not_optimize(routes.size());
+        });
+    }
+    facade::master().stop();
+    facade::master().set_replay_time_factor(time_factor);
+}
@@ -0,0 +1,145 @@
+#include "bench.h"
+#include "counter_facades.h"
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <facade.h>
+#include <worker_pool.h>
+
+namespace
+{
+    constexpr size_t passthrough_calls = 2'000'000;
+    // recorded calls are kept in memory until the recording is stopped
+    constexpr size_t recording_calls = 20'000;
+    constexpr size_t replay_calls = 200'000;
+    constexpr size_t pool_tasks = 200'000;
+    // calls are made with this many distinct arguments, so replay finds them all
+    constexpr int distinct_values = 64;
+
+    using namespace counter_facades;
+    // a thread gets a facade of its own up to eight threads
+    static_assert(counter_facades_num == 8);
+
+    // Runs body(thread_idx, call_idx) calls_per_thread times on every thread, the
+    // threads start together. Returns the wall time of the slowest thread
+    template <typename t_body>
+    double run_threads(size_t threads_num, size_t calls_per_thread, const t_body& body)
+    {
+        std::atomic<size_t> ready{0};
+        std::atomic_bool go{false};
+        std::vector<std::thread> threads;
+        for (size_t thread_idx = 0; thread_idx < threads_num; ++thread_idx) {
+            threads.emplace_back([&, thread_idx]() {
+                ++ready;
+                while (!go) std::this_thread::yield();
+                for (size_t call = 0; call < calls_per_thread; ++call) {
+                    body(thread_idx, call);
+                }
+            });
+        }
+        while (ready != threads_num) std::this_thread::yield();
+        const auto started = bench::t_clock::now();
+        go = true;
+        for (auto& thread : threads) thread.join();
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            bench::t_clock::now() - started)
+                                       .count());
+    }
+
+    void report(bench::state& state, const std::string& label, size_t threads_num,
+        size_t calls, double total_ns)
+    {
+        state.counter("threads", static_cast<double>(threads_num));
+        state.counter("calls_per_second", total_ns ? calls * 1e9 / total_ns : 0.0);
+        state.report(label, calls, total_ns);
+    }
+
+    // all the threads call one facade or each of them calls its own
+    void measure_calls(bench::state& state, const std::string& mode, bool shared,
+        size_t threads_num, size_t calls_per_thread, t_counter_facades& facades)
+    {
+        const auto total_ns = run_threads(
+            threads_num, calls_per_thread, [&](size_t thread_idx, size_t call) {
+                const size_t index = shared ? 0 : thread_idx % counter_facades_num;
+                with_facade(facades, index, [call](auto& facade) {
+                    bench::do_not_optimize(
+                        facade.square(static_cast<int>(call % distinct_values)));
+                });
+            });
+        const std::string label = mode + (shared ? "_one_facade/" : "_own_facades/") +
+            std::to_string(threads_num) + "_threads";
+        report(state, label, threads_num, threads_num * calls_per_thread, total_ns);
+    }
+
+    std::vector<size_t> thread_counts()
+    {
+        const size_t max_threads =
+            std::max<size_t>(2 * std::thread::hardware_concurrency(), 8);
+        std::vector<size_t> counts;
+        for (size_t threads_num = 1; threads_num <= std::min<size_t>(max_threads, 32);
+             threads_num *= 2) {
+            counts.push_back(threads_num);
+        }
+        return counts;
+    }
+}  // namespace
+
+// Throughput of facade calls made from more threads at once, the labels are
+// <mode>_<one_facade|own_facades>/<threads>. ns_per_op is the wall time divided by
+// the calls of all the threads, it stops going down where the calls stop scaling
+FACADE_BENCHMARK(scaling)
+{
+    const double time_factor = facade::master().get_replay_time_factor();
+    facade::master().set_replay_time_factor(0.0);
+    for (const size_t threads_num : thread_counts()) {
+        for (const bool shared : {true, false}) {
+            {
+                auto facades = make_counter_facades(true);
+                measure_calls(state, "passthrough", shared, threads_num,
+                    passthrough_calls / threads_num, *facades);
+            }
+
+            facade::master().start_recording();
+            {
+                auto facades = make_counter_facades(true);
+                measure_calls(
+                    state, "recording", shared, threads_num, recording_calls, *facades);
+            }
+            facade::master().stop();
+
+            facade::master().start_playing();
+            {
+                auto facades = make_counter_facades(false);
+                measure_calls(state, "replay", shared, threads_num,
+                    replay_calls / threads_num, *facades);
+            }
+            facade::master().stop();
+        }
+    }
+    facade::master().set_replay_time_factor(time_factor);
+}
+
+// tasks posted from more threads at once to a pool of four workers
+FACADE_BENCHMARK(worker_pool_scaling)
+{
+    for (const size_t threads_num : thread_counts()) {
+        facade::utils::worker_pool pool{4};
+        pool.start();
+        std::atomic<size_t> completed{0};
+        auto total_ns = run_threads(threads_num, pool_tasks / threads_num,
+            [&](size_t, size_t) { pool.post([&completed]() { ++completed; }); });
+        const auto started = bench::t_clock::now();
+        pool.wait_completion();
+        total_ns += static_cast<double>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                bench::t_clock::now() - started)
+                .count());
+        pool.stop();
+        report(state, "post/" + std::to_string(threads_num) + "_threads", threads_num,
+            completed, total_ns);
+    }
+}
@@ -0,0 +1,35 @@
+#include "bench.h"
+
+#include <atomic>
+#include <string>
+
+#include <worker_pool.h>
+
+namespace
+{
+    constexpr size_t tasks = 1'000'000;
+}  // namespace
+
+// Throughput of the dispatch path used to replay callbacks, the tasks do no work
+FACADE_BENCHMARK(worker_pool)
+{
+    for (const size_t workers : {1, 4, 16}) {
+        facade::utils::worker_pool pool{workers};
+        pool.start();
+        std::atomic<size_t> completed{0};
+        state.counter("workers", static_cast<double>(workers));
+        // includes waiting for the last task to complete
+        state.measure("submit_" + std::to_string(workers) + "_workers", tasks,
+            [&](size_t idx) {
+                pool.submit([&completed]() { ++completed; });
+                if (idx + 1 == tasks) pool.wait_completion();
+            });
+        // fire-and-forget, the way callbacks are dispatched
+        state.measure("post_" + std::to_string(workers) + "_workers", tasks,
+            [&](size_t idx) {
+                pool.post([&completed]() { ++completed; });
+                if (idx + 1 == tasks) pool.wait_completion();
+            });
+        pool.stop();
+    }
+}
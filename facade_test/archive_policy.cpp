@@ -0,0 +1,196 @@
+#include "facade.h"
+
+#include <gtest/gtest.h>
+
+namespace test_archive_policy
+{
+    class storage
+    {
+        std::vector<std::string> m_items{"first", "second"};
+
+    public:
+        size_t size() const { return m_items.size(); }
+        bool get(size_t index, std::string& item) const
+        {
+            if (index >= m_items.size()) return false;
+            item = m_items[index];
+            return true;
+        }
+        std::vector<std::string> find(const std::string& prefix) const
+        {
+            std::vector<std::string> found;
+            for (const auto& item : m_items) {
+                if (item.compare(0, prefix.size(), prefix) == 0) found.push_back(item);
+            }
+            return found;
+        }
+    };
+
+    class binary_storage_facade
+        : public facade::facade<storage, facade::binary_archive_policy>
+    {
+    public:
+        FACADE_CONSTRUCTOR(binary_storage_facade);
+        FACADE_METHOD(size);
+        FACADE_METHOD(get);
+        FACADE_METHOD(find);
+
+        // drops the recorded calls like a mode change does
+        void clear() { facade_clear(); }
+    };
+
+    void use(binary_storage_facade& facade, storage& original)
+    {
+        ASSERT_EQ(facade.size(), original.size());
+
+        std::string a_string, b_string;
+        for (size_t index = 0; index < 3; ++index) {
+            ASSERT_EQ(facade.get(index, a_string), original.get(index, b_string));
+            ASSERT_EQ(a_string, b_string);
+        }
+
+        ASSERT_EQ(facade.find(std::string{"s"}), original.find("s"));
+        ASSERT_EQ(facade.find(std::string{"none"}), original.find("none"));
+    }
+}  // namespace test_archive_policy
+
+TEST(archive_policy, binary_compare_results)
+{
+    using namespace test_archive_policy;
+    {
+        binary_storage_facade facade;
+        std::error_code ec;
+        std::filesystem::remove(facade::master().make_recording_path(facade), ec);
+    }
+    {
+        facade::master().start_recording();
+        binary_storage_facade facade{std::make_unique<storage>()};
+        storage original;
+        use(facade, original);
+    }
+    {
+        facade::master().start_playing();
+        binary_storage_facade facade;
+        storage original;
+        use(facade, original);
+
+        // payloads are stored as raw bytes, not as nested JSON documents
+        std::ifstream ifs{
+            facade::master().make_recording_path(facade), std::ios::binary};
+        const std::string content{std::istreambuf_iterator<char>{ifs}, {}};
+        ASSERT_EQ(content.find("value0"), std::string::npos);
+        facade::master().stop();
+    }
+}
+
+TEST(archive_policy, indexed_recording)
+{
+    using namespace test_archive_policy;
+    std::filesystem::path path;
+    {
+        facade::master().start_recording();
+        binary_storage_facade facade{std::make_unique<storage>()};
+        storage original;
+        use(facade, original);
+        path = facade::master().make_recording_path(facade);
+    }
+    facade::master().stop();
+
+    std::string content;
+    {
+        std::ifstream ifs{path, std::ios::binary};
+        content.assign(std::istreambuf_iterator<char>{ifs}, {});
+    }
+    ASSERT_TRUE(facade::recording_format::has_header(content.data(), content.size()));
+
+    // a recording without its index can't be loaded
+    {
+        std::ofstream ofs{path, std::ios::binary | std::ios::trunc};
+        ofs.write(content.data(), content.size() - 1);
+    }
+    facade::master().start_playing();
+    ASSERT_THROW(binary_storage_facade{}, std::runtime_error);
+    facade::master().stop();
+}
+
+TEST(archive_policy, streamed_recording)
+{
+    using namespace test_archive_policy;
+    // a tiny budget makes every recorded call go into a segment of its own
+    facade::master().set_streaming_recording(true, 1, std::chrono::milliseconds{1});
+    std::filesystem::path path;
+    {
+        facade::master().start_recording();
+        binary_storage_facade facade{std::make_unique<storage>()};
+        storage original;
+        use(facade, original);
+        path = facade::master().make_recording_path(facade);
+        facade::master().stop();
+    }
+    facade::master().set_streaming_recording(false);
+    ASSERT_EQ(facade::master().get_unflushed_bytes(), 0);
+
+    std::string content;
+    {
+        std::ifstream ifs{path, std::ios::binary};
+        content.assign(std::istreambuf_iterator<char>{ifs}, {});
+    }
+    const std::string segment_magic{facade::recording_format::segment_magic,
+        sizeof(facade::recording_format::segment_magic)};
+    size_t segments = 0;
+    for (auto pos = content.find(segment_magic); pos != std::string::npos;
+         pos = content.find(segment_magic, pos + 1)) {
+        ++segments;
+    }
+    ASSERT_GT(segments, 1);
+    {
+        facade::master().start_playing();
+        binary_storage_facade facade;
+        storage original;
+        use(facade, original);
+        facade::master().stop();
+    }
+
+    // the segments written before a crash can still be replayed
+    {
+        std::ofstream ofs{path, std::ios::binary | std::ios::trunc};
+        ofs.write(content.data(), content.size() - 1);
+    }
+    facade::master().start_playing();
+    {
+        binary_storage_facade facade;
+        storage original;
+        ASSERT_EQ(facade.size(), original.size());
+    }
+    facade::master().stop();
+}
+
+// the calls of a cleared facade don't count against the memory budget any more
+TEST(archive_policy, streamed_recording_of_cleared_facade)
+{
+    using namespace test_archive_policy;
+    // nothing is flushed until the recording is finished
+    facade::master().set_streaming_recording(true, 1 << 30, std::chrono::hours{1});
+    facade::master().start_recording();
+    {
+        binary_storage_facade facade{std::make_unique<storage>()};
+        storage original;
+        use(facade, original);
+        const size_t recorded = facade::master().get_unflushed_bytes();
+        ASSERT_GT(recorded, 0);
+
+        facade.clear();
+        ASSERT_EQ(facade::master().get_unflushed_bytes(), 0);
+        use(facade, original);
+        ASSERT_EQ(facade::master().get_unflushed_bytes(), recorded);
+        // merged calls are released too
+        std::ostringstream saved;
+        facade.facade_save(saved);
+        facade.clear();
+        ASSERT_EQ(facade::master().get_unflushed_bytes(), 0);
+        use(facade, original);
+    }
+    facade::master().stop();
+    facade::master().set_streaming_recording(false);
+    ASSERT_EQ(facade::master().get_unflushed_bytes(), 0);
+}
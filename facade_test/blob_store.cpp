@@ -0,0 +1,124 @@
+#include "facade.h"
+#include "recorded_facades.h"
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+namespace test_blob_store
+{
+    using namespace recorded_facades;
+
+    struct status
+    {
+        int code{0};
+        std::string text;
+
+        template <class t_archive>
+        void serialize(t_archive& archive)
+        {
+            archive(code, text);
+        }
+    };
+
+    class device
+    {
+        int m_polls{0};
+
+    public:
+        status get_status() const { return {200, "a rather long and unchanging status"}; }
+        int poll() { return ++m_polls % 2; }
+    };
+
+    class json_device_facade : public facade::facade<device>
+    {
+    public:
+        FACADE_CONSTRUCTOR(json_device_facade);
+        FACADE_METHOD(get_status);
+        FACADE_METHOD(poll);
+    };
+
+    class binary_device_facade
+        : public facade::facade<device, facade::binary_archive_policy>
+    {
+    public:
+        FACADE_CONSTRUCTOR(binary_device_facade);
+        FACADE_METHOD(get_status);
+        FACADE_METHOD(poll);
+    };
+
+    constexpr int calls_num = 1000;
+
+    template <typename t_facade>
+    void record_and_replay()
+    {
+        const auto path =
+            record<t_facade>(std::make_unique<device>(), [](t_facade& facade) {
+                for (int idx = 0; idx < calls_num; ++idx) {
+                    facade.get_status();
+                    facade.poll();
+                }
+            });
+
+        // the status is in the recording once, not once per call
+        const auto content = read_recording(path);
+        const auto first = content.find("unchanging");
+        ASSERT_NE(first, std::string::npos);
+        ASSERT_EQ(content.find("unchanging", first + 1), std::string::npos);
+
+        replay<t_facade>([](t_facade& facade) {
+            for (int idx = 0; idx < calls_num; ++idx) {
+                const auto replayed = facade.get_status();
+                ASSERT_EQ(replayed.code, 200);
+                ASSERT_EQ(replayed.text, "a rather long and unchanging status");
+                ASSERT_EQ(facade.poll(), (idx + 1) % 2);
+            }
+        });
+    }
+}  // namespace test_blob_store
+
+TEST(blob_store, interning)
+{
+    facade::blob_store blobs;
+    ASSERT_EQ(blobs.intern(""), 0);
+    ASSERT_TRUE(blobs.get(0).empty());
+
+    const auto first = blobs.intern("payload");
+    ASSERT_EQ(blobs.intern("payload"), first);
+    const auto second = blobs.intern("other payload");
+    ASSERT_NE(second, first);
+    ASSERT_EQ(blobs.get(first), "payload");
+    ASSERT_EQ(blobs.get(second), "other payload");
+    ASSERT_EQ(blobs.size(), 2);
+    ASSERT_EQ(blobs.bytes(), 20);
+
+    // loaded blobs keep their ids even if they are equal
+    ASSERT_EQ(blobs.add("payload"), 3);
+    ASSERT_THROW(blobs.get(4), std::runtime_error);
+
+    blobs.clear();
+    ASSERT_TRUE(blobs.empty());
+}
+
+// payloads interned into a loaded store are stored once with the loaded blobs
+TEST(blob_store, loaded_blobs_are_interned)
+{
+    const std::string mapped = "mapped payload";
+    facade::blob_store blobs;
+    ASSERT_EQ(blobs.add("payload"), 1);
+    ASSERT_EQ(blobs.add_view(mapped), 2);
+    ASSERT_EQ(blobs.size(), 2);
+
+    ASSERT_EQ(blobs.intern("payload"), 1);
+    ASSERT_EQ(blobs.intern("mapped payload"), 2);
+    ASSERT_EQ(blobs.size(), 2);
+    ASSERT_EQ(blobs.intern("new payload"), 3);
+    ASSERT_EQ(blobs.size(), 3);
+}
+
+TEST(blob_store, repeated_results_are_stored_once)
+{
+    using namespace test_blob_store;
+    record_and_replay<json_device_facade>();
+    record_and_replay<binary_device_facade>();
+}
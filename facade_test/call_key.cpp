@@ -0,0 +1,192 @@
+#include "facade.h"
+#include "recorded_facades.h"
+
+#include <cctype>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace test_call_key
+{
+    using namespace recorded_facades;
+
+    struct point
+    {
+        int x{0};
+        int y{0};
+
+        template <class t_archive>
+        void serialize(t_archive& archive)
+        {
+            archive(x, y);
+        }
+    };
+
+    enum class color
+    {
+        red,
+        green
+    };
+
+    class calculator
+    {
+    public:
+        int add(int lhv, int rhv) const { return lhv + rhv; }
+        size_t length(const std::string& text) const { return text.size(); }
+        // a text has the same key as the hash of its bytes followed by its size
+        size_t length(uint64_t, uint64_t size) const { return 10 * size; }
+    };
+
+    class call_key_facade : public facade::facade<calculator>
+    {
+    public:
+        FACADE_CONSTRUCTOR(call_key_facade);
+        FACADE_METHOD(add);
+        FACADE_METHOD(length);
+    };
+
+    class binary_call_key_facade
+        : public facade::facade<calculator, facade::binary_archive_policy>
+    {
+    public:
+        FACADE_CONSTRUCTOR(binary_call_key_facade);
+        FACADE_METHOD(add);
+        FACADE_METHOD(length);
+    };
+
+    // refers to an argument of either overload of length, so a single filter can
+    // be declared for both of them
+    struct length_arg
+    {
+        std::string* text{nullptr};
+
+        length_arg() = default;
+        length_arg(std::string& value) : text(&value) {}
+        length_arg(uint64_t&) {}
+    };
+
+    // texts are recorded in upper case
+    class filtered_call_key_facade : public facade::facade<calculator>
+    {
+    public:
+        FACADE_CONSTRUCTOR(filtered_call_key_facade);
+        FACADE_METHOD(length);
+        size_t filter_length(length_arg arg, length_arg = {})
+        {
+            if (arg.text) {
+                for (auto& c : *arg.text) c = static_cast<char>(std::toupper(c));
+            }
+            return 0;
+        }
+    };
+
+    template <typename t_facade>
+    void replay_calls_sharing_a_key()
+    {
+        const std::string text{"ab"};
+        const uint64_t hash = facade::utils::hash64(text);
+        const uint64_t size = text.size();
+        record<t_facade>(std::make_unique<calculator>(), [&](t_facade& facade) {
+            ASSERT_EQ(facade.length(text), 2);
+            ASSERT_EQ(facade.length(hash, size), 20);
+            ASSERT_EQ(facade.length(text), 2);
+        });
+        replay<t_facade>([&](t_facade& facade) {
+            ASSERT_EQ(facade.length(hash, size), 20);
+            ASSERT_EQ(facade.length(text), 2);
+            ASSERT_EQ(facade.length(text), 2);
+            ASSERT_EQ(facade.length(std::string{"ba"}), 0);
+        });
+    }
+}  // namespace test_call_key
+
+TEST(call_key, values)
+{
+    using namespace test_call_key;
+    using facade::calculate_key;
+
+    ASSERT_EQ(calculate_key(), 0);
+
+    // the same values held by different types
+    ASSERT_EQ(calculate_key(1, 2), calculate_key(1L, static_cast<short>(2)));
+    ASSERT_EQ(calculate_key(2.5f), calculate_key(2.5));
+    ASSERT_EQ(calculate_key("text"), calculate_key(std::string{"text"}));
+    const char* const text = "text";
+    ASSERT_EQ(calculate_key(text), calculate_key("text"));
+    const char* const null_text = nullptr;
+    ASSERT_NE(calculate_key(null_text), calculate_key(""));
+    ASSERT_EQ(calculate_key(std::vector<int>{1, 2}), calculate_key(std::vector<long>{1, 2}));
+    ASSERT_EQ(calculate_key(color::green), calculate_key(1));
+
+    ASSERT_NE(calculate_key(1, 2), calculate_key(2, 1));
+    ASSERT_NE(calculate_key(-1), calculate_key(1));
+    ASSERT_NE(calculate_key(std::string{"ab"}, std::string{"c"}),
+        calculate_key(std::string{"a"}, std::string{"bc"}));
+    ASSERT_NE(calculate_key(std::vector<std::vector<int>>{{1}, {2}}),
+        calculate_key(std::vector<std::vector<int>>{{1, 2}}));
+    ASSERT_NE(calculate_key(std::optional<int>{}), calculate_key(std::optional<int>{0}));
+
+    const std::map<std::string, int> map{{"a", 1}, {"b", 2}};
+    ASSERT_EQ(calculate_key(map), calculate_key(std::map<std::string, int>{map}));
+    ASSERT_NE(calculate_key(map), calculate_key(std::map<std::string, int>{{"a", 1}}));
+
+    // types the hasher doesn't know are hashed by their serialization
+    ASSERT_EQ(calculate_key(point{1, 2}), calculate_key(point{1, 2}));
+    ASSERT_NE(calculate_key(point{1, 2}), calculate_key(point{2, 1}));
+}
+
+TEST(call_key, other_version_is_rejected)
+{
+    using namespace test_call_key;
+    const auto path = record<call_key_facade>(std::make_unique<calculator>(),
+        [](call_key_facade& facade) { ASSERT_EQ(facade.add(1, 2), 3); });
+
+    // a recording made before the version was saved
+    {
+        std::ofstream ofs{path, std::ios::trunc};
+        ofs << R"({"name": "call_key_facade", "calls": [], "callbacks": []})";
+    }
+    facade::master().start_playing();
+    ASSERT_THROW(call_key_facade{}, std::runtime_error);
+    facade::master().stop();
+}
+
+// arguments that have the same key as other recorded ones replay their own results
+TEST(call_key, calls_sharing_a_key_are_told_apart)
+{
+    using namespace test_call_key;
+    const std::string text{"ab"};
+    ASSERT_EQ(facade::calculate_key(text),
+        facade::calculate_key(facade::utils::hash64(text), uint64_t{text.size()}));
+
+    replay_calls_sharing_a_key<call_key_facade>();
+    replay_calls_sharing_a_key<binary_call_key_facade>();
+    facade::master().set_streaming_recording(true);
+    replay_calls_sharing_a_key<call_key_facade>();
+    facade::master().set_streaming_recording(false);
+}
+
+// the key and the arguments of a call to a method with a filter are looked up
+// filtered, as they were recorded
+TEST(call_key, filtered_calls_sharing_a_key_are_told_apart)
+{
+    using namespace test_call_key;
+    const std::string text{"ab"};
+    const uint64_t hash = facade::utils::hash64(std::string{"AB"});
+    const uint64_t size = text.size();
+    record<filtered_call_key_facade>(
+        std::make_unique<calculator>(), [&](filtered_call_key_facade& facade) {
+            ASSERT_EQ(facade.length(text), 2);
+            ASSERT_EQ(facade.length(hash, size), 20);
+        });
+    replay<filtered_call_key_facade>([&](filtered_call_key_facade& facade) {
+        ASSERT_EQ(facade.length(hash, size), 20);
+        ASSERT_EQ(facade.length(text), 2);
+        ASSERT_EQ(facade.length(std::string{"AB"}), 2);
+        ASSERT_EQ(facade.length(std::string{"ba"}), 0);
+    });
+}
@@ -0,0 +1,191 @@
+#include "facade.h"
+#include "recorded_facades.h"
+
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+namespace test_compression
+{
+    using namespace recorded_facades;
+
+    class sensor
+    {
+        int m_reads{0};
+
+    public:
+        std::string read(int channel)
+        {
+            return "channel " + std::to_string(channel) + " reads " +
+                std::to_string(++m_reads % 7);
+        }
+    };
+
+    class compressed_sensor_facade : public facade::facade<sensor>
+    {
+    public:
+        FACADE_CONSTRUCTOR(compressed_sensor_facade);
+        FACADE_METHOD(read);
+    };
+
+    class compressed_binary_sensor_facade
+        : public facade::facade<sensor, facade::binary_archive_policy>
+    {
+    public:
+        FACADE_CONSTRUCTOR(compressed_binary_sensor_facade);
+        FACADE_METHOD(read);
+    };
+
+    std::string round_trip(const std::string& data)
+    {
+        std::string compressed(facade::utils::lz4::compress_bound(data.size()), '\0');
+        compressed.resize(
+            facade::utils::lz4::compress(data.data(), data.size(), compressed.data()));
+        std::string decompressed(data.size(), '\0');
+        EXPECT_TRUE(facade::utils::lz4::decompress(compressed.data(), compressed.size(),
+            decompressed.data(), decompressed.size()));
+        return decompressed;
+    }
+
+    template <typename t_facade>
+    void record_and_replay()
+    {
+        const auto path = record<t_facade>(std::make_unique<sensor>(),
+            [](t_facade& facade) {
+                for (int idx = 0; idx < 500; ++idx) facade.read(idx % 3);
+            });
+        const auto content = read_recording(path);
+        ASSERT_TRUE(
+            facade::recording_format::is_compressed(content.data(), content.size()));
+
+        replay<t_facade>([](t_facade& facade) {
+            sensor original;
+            for (int idx = 0; idx < 500; ++idx) {
+                ASSERT_EQ(facade.read(idx % 3), original.read(idx % 3));
+            }
+        });
+    }
+
+    // the recording is loaded by start_playing, which decompresses its blocks on
+    // the I/O workers
+    template <typename t_facade>
+    void replay_blocks_decompressed_in_parallel()
+    {
+        t_facade facade{std::make_unique<sensor>()};
+        facade::master().start_recording();
+        for (int idx = 0; idx < 500; ++idx) facade.read(idx % 3);
+        facade::master().stop();
+        {
+            const auto content =
+                read_recording(facade::master().make_recording_path(facade));
+            const facade::recording_format::compressed_view view{
+                content.data(), content.size()};
+            ASSERT_GT(view.blocks(), 4);
+        }
+
+        facade::master().start_playing();
+        sensor original;
+        for (int idx = 0; idx < 500; ++idx) {
+            ASSERT_EQ(facade.read(idx % 3), original.read(idx % 3));
+        }
+        facade::master().stop();
+    }
+}  // namespace test_compression
+
+TEST(compression, lz4_round_trip)
+{
+    using namespace test_compression;
+    ASSERT_EQ(round_trip(""), "");
+    ASSERT_EQ(round_trip("short"), "short");
+
+    std::string repetitive;
+    for (int idx = 0; idx < 10000; ++idx) {
+        repetitive += "\"value0\": " + std::to_string(idx % 10);
+    }
+    ASSERT_EQ(round_trip(repetitive), repetitive);
+    ASSERT_EQ(round_trip(std::string(100000, 'a')), std::string(100000, 'a'));
+
+    std::mt19937 random{42};
+    std::string noise(100000, '\0');
+    for (auto& byte : noise) byte = static_cast<char>(random());
+    ASSERT_EQ(round_trip(noise), noise);
+}
+
+TEST(compression, corrupted_input_is_rejected)
+{
+    std::string data;
+    for (int idx = 0; idx < 1000; ++idx) {
+        data += "line " + std::to_string(idx % 10) + "\n";
+    }
+    std::ostringstream compressed;
+    facade::recording_format::write_compressed(compressed, data, 1024);
+    const std::string container = compressed.str();
+    ASSERT_LT(container.size(), data.size() / 4);
+
+    const facade::recording_format::compressed_view view{
+        container.data(), container.size()};
+    ASSERT_EQ(view.blocks(), (data.size() + 1023) / 1024);
+    ASSERT_EQ(view.decompress(), data);
+
+    // a block cut short
+    std::string cut = container;
+    facade::recording_format::compressed_block first_block;
+    const size_t first_block_offset = sizeof(facade::recording_format::compressed_header);
+    std::memcpy(&first_block, cut.data() + first_block_offset, sizeof(first_block));
+    --first_block.size;
+    std::memcpy(cut.data() + first_block_offset, &first_block, sizeof(first_block));
+    ASSERT_THROW(
+        facade::recording_format::compressed_view(cut.data(), cut.size()).decompress(),
+        std::runtime_error);
+
+    // a truncated container
+    ASSERT_THROW(facade::recording_format::compressed_view(
+                     container.data(), container.size() / 2),
+        std::runtime_error);
+}
+
+TEST(compression, compressed_recordings)
+{
+    using namespace test_compression;
+    facade::master().set_recording_compression(true, 4096);
+    record_and_replay<compressed_sensor_facade>();
+    record_and_replay<compressed_binary_sensor_facade>();
+    facade::master().set_recording_compression(false);
+}
+
+TEST(compression, blocks_decompressed_in_parallel)
+{
+    using namespace test_compression;
+    const size_t io_workers = facade::master().get_number_of_io_workers();
+    facade::master().set_number_of_io_workers(4);
+    facade::master().set_recording_compression(true, 256);
+    replay_blocks_decompressed_in_parallel<compressed_sensor_facade>();
+    replay_blocks_decompressed_in_parallel<compressed_binary_sensor_facade>();
+    facade::master().set_recording_compression(false);
+    facade::master().set_number_of_io_workers(io_workers);
+}
+
+TEST(compression, client_streams_get_compressed_recordings)
+{
+    using namespace test_compression;
+    std::ostringstream stream;
+    facade::master().set_get_facade_stream_callback(
+        [&stream](const std::string&) -> std::ostream* { return &stream; });
+    facade::master().set_recording_compression(true);
+    {
+        facade::master().start_recording();
+        compressed_sensor_facade facade{std::make_unique<sensor>()};
+        facade.read(1);
+        facade::master().stop();
+    }
+    facade::master().set_recording_compression(false);
+    facade::master().set_get_facade_stream_callback(nullptr);
+
+    const std::string content = stream.str();
+    ASSERT_TRUE(facade::recording_format::is_compressed(content.data(), content.size()));
+    const facade::recording_format::compressed_view view{content.data(), content.size()};
+    ASSERT_NE(view.decompress().find("compressed_sensor_facade"), std::string::npos);
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <tuple>
+
+#include <facade.h>
+
+// Facades of the same class recorded to files of their own, shared by the tests
+// and the benchmarks that make calls from more threads through more facades
+namespace counter_facades
+{
+    class counter
+    {
+    public:
+        int square(int value) const { return value * value; }
+        std::string label(int value) const { return "label " + std::to_string(value); }
+        bool describe(int value, std::string& description) const
+        {
+            description = "value " + std::to_string(value);
+            return value % 2 == 0;
+        }
+    };
+
+    // declares another facade of counter, recorded to a file of its own
+#define COUNTER_FACADE(_NAME)                    \
+    class _NAME : public facade::facade<counter> \
+    {                                            \
+    public:                                      \
+        FACADE_CONSTRUCTOR(_NAME);               \
+        FACADE_METHOD(square);                   \
+        FACADE_METHOD(label);                    \
+        FACADE_METHOD(describe);                 \
+    }
+
+    COUNTER_FACADE(counter_facade_0);
+    COUNTER_FACADE(counter_facade_1);
+    COUNTER_FACADE(counter_facade_2);
+    COUNTER_FACADE(counter_facade_3);
+    COUNTER_FACADE(counter_facade_4);
+    COUNTER_FACADE(counter_facade_5);
+    COUNTER_FACADE(counter_facade_6);
+    COUNTER_FACADE(counter_facade_7);
+
+    using t_counter_facades = std::tuple<counter_facade_0, counter_facade_1,
+        counter_facade_2, counter_facade_3, counter_facade_4, counter_facade_5,
+        counter_facade_6, counter_facade_7>;
+    constexpr size_t counter_facades_num = std::tuple_size<t_counter_facades>::value;
+
+    // facades with implementations record and pass calls through, the others replay
+    inline std::unique_ptr<t_counter_facades> make_counter_facades(bool with_impl)
+    {
+        if (!with_impl) return std::make_unique<t_counter_facades>();
+        const auto impl = []() { return std::make_unique<counter>(); };
+        return std::make_unique<t_counter_facades>(
+            impl(), impl(), impl(), impl(), impl(), impl(), impl(), impl());
+    }
+
+    // calls body with the facade at the index
+    template <typename t_body>
+    void with_facade(t_counter_facades& facades, size_t index, const t_body& body)
+    {
+        std::apply(
+            [&](auto&... facade) {
+                size_t facade_idx = 0;
+                ((facade_idx++ == index ? body(facade) : void()), ...);
+            },
+            facades);
+    }
+}  // namespace counter_facades
@@ -0,0 +1,93 @@
+#include "facade.h"
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace test_decoded_results
+{
+    class network
+    {
+        int m_requests{0};
+
+    public:
+        std::string get_local_ip()
+        {
+            return "192.168.0." + std::to_string(++m_requests);
+        }
+        bool find_routes(const std::string& prefix, std::vector<std::string>& routes)
+        {
+            routes = {prefix + ".0/8", prefix + ".1/8"};
+            return true;
+        }
+        void resolve(const std::string& host, std::string& address)
+        {
+            address = host + "." + std::to_string(++m_requests);
+        }
+    };
+
+    class decoded_network_facade : public facade::facade<network>
+    {
+    public:
+        FACADE_CONSTRUCTOR(decoded_network_facade);
+        FACADE_METHOD(get_local_ip);
+        FACADE_METHOD(find_routes);
+        FACADE_METHOD(resolve);
+    };
+}  // namespace test_decoded_results
+
+TEST(decoded_results, cache)
+{
+    facade::decoded_result_cache cache;
+    size_t decoded = 0;
+    const auto decode = [&decoded](std::string& value) {
+        value = "decoded";
+        ++decoded;
+    };
+    ASSERT_EQ(cache.find<std::string>(), nullptr);
+    ASSERT_EQ(*cache.emplace<std::string>(decode), "decoded");
+    ASSERT_EQ(*cache.emplace<std::string>(decode), "decoded");
+    ASSERT_EQ(decoded, 1);
+
+    // values of other types aren't taken from the cache
+    ASSERT_EQ(cache.find<int>(), nullptr);
+    ASSERT_EQ(cache.emplace<int>([](int& value) { value = 1; }), nullptr);
+
+    const facade::decoded_result_cache copy{cache};
+    ASSERT_EQ(copy.find<std::string>(), nullptr);
+    const facade::decoded_result_cache moved{std::move(cache)};
+    ASSERT_EQ(*moved.find<std::string>(), "decoded");
+}
+
+TEST(decoded_results, cycled_replays)
+{
+    using namespace test_decoded_results;
+    {
+        facade::master().start_recording();
+        decoded_network_facade facade{std::make_unique<network>()};
+        facade.get_local_ip();
+        facade.get_local_ip();
+        std::vector<std::string> routes;
+        facade.find_routes(std::string{"10"}, routes);
+        std::string address;
+        facade.resolve(std::string{"host"}, address);
+        facade::master().stop();
+    }
+
+    facade::master().start_playing();
+    decoded_network_facade facade;
+    for (int round = 0; round < 3; ++round) {
+        ASSERT_EQ(facade.get_local_ip(), "192.168.0.1");
+        ASSERT_EQ(facade.get_local_ip(), "192.168.0.2");
+
+        std::vector<std::string> routes;
+        ASSERT_TRUE(facade.find_routes(std::string{"10"}, routes));
+        ASSERT_EQ(routes, (std::vector<std::string>{"10.0/8", "10.1/8"}));
+
+        std::string address;
+        facade.resolve(std::string{"host"}, address);
+        ASSERT_EQ(address, "host.3");
+    }
+    facade::master().stop();
+}
@@ -0,0 +1,37 @@
+#include "flat_map.h"
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+TEST(flat_map, insert_and_find)
+{
+    facade::utils::flat_map<uint64_t, std::string> map;
+    ASSERT_EQ(map.find(0), nullptr);
+
+    constexpr uint64_t keys = 10000;
+    for (uint64_t key = 0; key < keys; ++key) {
+        const auto [value, inserted] = map.try_emplace(key * 7919, std::to_string(key));
+        ASSERT_TRUE(inserted);
+    }
+    ASSERT_EQ(map.size(), keys);
+
+    const auto [existing, inserted] = map.try_emplace(7919, "duplicate");
+    ASSERT_FALSE(inserted);
+    ASSERT_EQ(*existing, "1");
+
+    for (uint64_t key = 0; key < keys; ++key) {
+        const auto* value = map.find(key * 7919);
+        ASSERT_NE(value, nullptr);
+        ASSERT_EQ(*value, std::to_string(key));
+    }
+    ASSERT_EQ(map.find(1), nullptr);
+
+    // entries are kept in insertion order
+    uint64_t expected = 0;
+    for (const auto& [key, value] : map) ASSERT_EQ(key, 7919 * expected++);
+
+    map.clear();
+    ASSERT_TRUE(map.empty());
+    ASSERT_EQ(map.find(0), nullptr);
+}
@@ -0,0 +1,150 @@
+#include "facade.h"
+#include "recorded_facades.h"
+
+#include <filesystem>
+#include <string>
+
+#include <gtest/gtest.h>
+
+namespace test_hybrid
+{
+    using namespace recorded_facades;
+
+    template <typename t_facade>
+    void record_scaled(int first, int last, int factor)
+    {
+        record<t_facade>(std::make_unique<scaler>(factor), [=](t_facade& facade) {
+            for (int value = first; value <= last; ++value) facade.scale(value);
+        });
+    }
+
+    template <typename t_facade>
+    void expect_replayed(int first, int last, int factor)
+    {
+        replay<t_facade>([=](t_facade& facade) {
+            for (int value = first; value <= last; ++value) {
+                ASSERT_EQ(facade.scale(value), value * factor) << value;
+            }
+        });
+    }
+
+    template <typename t_facade>
+    void misses_are_merged(bool stop_while_alive)
+    {
+        record_scaled<t_facade>(0, 4, 10);
+
+        facade::master().start_hybrid();
+        {
+            t_facade facade{std::make_unique<scaler>(100)};
+            for (int value = 0; value <= 7; ++value) {
+                const int factor = value <= 4 ? 10 : 100;
+                ASSERT_EQ(facade.scale(value), value * factor) << value;
+            }
+            if (stop_while_alive) facade::master().stop();
+        }
+        facade::master().stop();
+
+        expect_replayed<t_facade>(0, 4, 10);
+        expect_replayed<t_facade>(5, 7, 100);
+    }
+}  // namespace test_hybrid
+
+TEST(hybrid, misses_are_recorded_and_merged)
+{
+    using namespace test_hybrid;
+    misses_are_merged<scaler_facade>(false);
+    misses_are_merged<scaler_facade>(true);
+}
+
+// the merged recording replaces the file the replayed one is mapped from
+TEST(hybrid, misses_are_merged_into_indexed_recordings)
+{
+    using namespace test_hybrid;
+    misses_are_merged<binary_scaler_facade>(false);
+    misses_are_merged<binary_scaler_facade>(true);
+
+    facade::master().set_recording_compression(true);
+    misses_are_merged<binary_scaler_facade>(false);
+    facade::master().set_recording_compression(false);
+}
+
+// a facade replays the file it mapped while another facade merges its misses into
+// the recording, the merged recording replaces the file instead of overwriting it
+TEST(hybrid, merged_recordings_replace_mapped_ones)
+{
+    using namespace test_hybrid;
+    record_scaled<binary_scaler_facade>(0, 4, 10);
+    const auto path = std::filesystem::absolute(recording_path<binary_scaler_facade>());
+
+    facade::master().start_hybrid();
+    {
+        binary_scaler_facade mapping{std::make_unique<scaler>(100)};
+        ASSERT_EQ(mapping.scale(1), 10);
+        {
+            binary_scaler_facade merging{std::make_unique<scaler>(100)};
+            for (int value = 5; value <= 7; ++value) {
+                ASSERT_EQ(merging.scale(value), value * 100);
+            }
+        }
+        for (int value = 0; value <= 4; ++value) {
+            ASSERT_EQ(mapping.scale(value), value * 10) << value;
+        }
+    }
+    facade::master().stop();
+
+    for (const auto& entry : std::filesystem::directory_iterator{path.parent_path()}) {
+        const auto name = entry.path().filename().string();
+        ASSERT_NE(name.rfind(path.filename().string() + ".tmp", 0), 0u) << name;
+    }
+    expect_replayed<binary_scaler_facade>(0, 4, 10);
+    expect_replayed<binary_scaler_facade>(5, 7, 100);
+}
+
+TEST(hybrid, recordings_without_misses_are_left_as_they_are)
+{
+    using namespace test_hybrid;
+    record_scaled<scaler_facade>(0, 4, 10);
+    const auto path = recording_path<scaler_facade>();
+    const auto recorded = read_recording(path);
+
+    facade::master().start_hybrid();
+    {
+        scaler_facade facade{std::make_unique<scaler>(100)};
+        for (int value = 0; value <= 4; ++value) {
+            ASSERT_EQ(facade.scale(value), value * 10);
+        }
+    }
+    {
+        // without an implementation a miss is only replayed as a default value
+        scaler_facade facade;
+        ASSERT_EQ(facade.scale(42), 0);
+    }
+    facade::master().stop();
+
+    ASSERT_EQ(read_recording(path), recorded);
+}
+
+TEST(hybrid, facades_without_recordings_record_all_calls)
+{
+    using namespace test_hybrid;
+    std::filesystem::remove(recording_path<scaler_facade>());
+
+    facade::master().set_stats_collection(true);
+    facade::master().start_hybrid();
+    {
+        scaler_facade facade{std::make_unique<scaler>(100)};
+        for (int value = 0; value <= 4; ++value) {
+            ASSERT_EQ(facade.scale(value), value * 100);
+        }
+    }
+    facade::master().stop();
+    facade::master().set_stats_collection(false);
+
+    const auto stats = facade::master().get_stats();
+    const auto* scale = stats.find("scaler_facade", "scale");
+    ASSERT_NE(scale, nullptr);
+    ASSERT_EQ(scale->misses, 5);
+    ASSERT_EQ(scale->recorded, 5);
+
+    expect_replayed<scaler_facade>(0, 4, 100);
+}
@@ -1,5 +1,424 @@
+#include "facade.h"
+#include "counter_facades.h"
+
+#include <filesystem>
+#include <map>
+#include <thread>
+#include <tuple>
+#include <vector>
+
 #include <gtest/gtest.h>
 
+namespace test_multithread
+{
+    using namespace counter_facades;
+
+    COUNTER_FACADE(counter_facade);
+
+    // tells how many recording buffers of threads the facade holds
+    class buffered_counter_facade : public facade::facade<counter>
+    {
+    public:
+        FACADE_CONSTRUCTOR(buffered_counter_facade);
+        FACADE_METHOD(square);
+
+        size_t recording_buffers()
+        {
+            std::lock_guard<std::mutex> lg(m_buffers_mtx);
+            return m_buffers.size();
+        }
+    };
+
+    class sequence
+    {
+        int m_last{0};
+
+    public:
+        int next() { return ++m_last; }
+    };
+
+    class sequence_facade : public facade::facade<sequence>
+    {
+    public:
+        FACADE_CONSTRUCTOR(sequence_facade);
+        FACADE_METHOD(next);
+    };
+
+    class slow_counter
+    {
+    public:
+        std::atomic_bool entered{false};
+        int slow_square(int value)
+        {
+            entered = true;
+            std::this_thread::sleep_for(std::chrono::milliseconds{50});
+            return value * value;
+        }
+    };
+
+    class slow_counter_facade : public facade::facade<slow_counter>
+    {
+    public:
+        FACADE_CONSTRUCTOR(slow_counter_facade);
+        FACADE_METHOD(slow_square);
+    };
+
+    constexpr int threads_number = 8;
+    constexpr int calls_per_thread = 200;
+    // every iteration of record() makes three calls
+    constexpr uint64_t recorded_calls_number = 3 * threads_number * calls_per_thread;
+
+    template <typename t_body>
+    void run_threads(const t_body& body, int threads_num = threads_number)
+    {
+        std::vector<std::thread> threads;
+        for (int thread_idx = 0; thread_idx < threads_num; ++thread_idx) {
+            threads.emplace_back([&body, thread_idx]() { body(thread_idx); });
+        }
+        for (auto& thread : threads) thread.join();
+    }
+
+    template <typename t_facade>
+    void record_thread_calls(t_facade& facade, int thread_idx)
+    {
+        for (int call = 0; call < calls_per_thread; ++call) {
+            const int value = thread_idx * calls_per_thread + call;
+            std::string description;
+            facade.square(value);
+            facade.label(value);
+            facade.describe(value, description);
+        }
+    }
+
+    template <typename t_facade>
+    int count_thread_mismatches(t_facade& facade, int thread_idx)
+    {
+        counter original;
+        int mismatches = 0;
+        for (int call = 0; call < calls_per_thread; ++call) {
+            const int value = thread_idx * calls_per_thread + call;
+            if (facade.square(value) != original.square(value)) ++mismatches;
+            if (facade.label(value) != original.label(value)) ++mismatches;
+            std::string a_string, b_string;
+            if (facade.describe(value, a_string) != original.describe(value, b_string) ||
+                a_string != b_string) {
+                ++mismatches;
+            }
+        }
+        return mismatches;
+    }
+
+    void record(counter_facade& facade, int threads_num = threads_number)
+    {
+        run_threads(
+            [&facade](int thread_idx) { record_thread_calls(facade, thread_idx); },
+            threads_num);
+    }
+
+    int count_mismatches(counter_facade& facade, int threads_num = threads_number)
+    {
+        std::atomic_int mismatches{0};
+        run_threads(
+            [&](int thread_idx) {
+                mismatches += count_thread_mismatches(facade, thread_idx);
+            },
+            threads_num);
+        return mismatches;
+    }
+}  // namespace test_multithread
+
 TEST(multithread, compare_results)
 {
-}
\ No newline at end of file
+    using namespace test_multithread;
+    {
+        facade::master().start_recording();
+        counter_facade facade{std::make_unique<counter>()};
+        record(facade);
+        facade::master().stop();
+    }
+    {
+        facade::master().start_playing();
+        counter_facade facade;
+        const auto mismatches = count_mismatches(facade);
+        facade::master().stop();
+        ASSERT_EQ(mismatches, 0);
+    }
+}
+
+TEST(multithread, async_serialization)
+{
+    using namespace test_multithread;
+    facade::master().set_async_serialization(true);
+    {
+        facade::master().start_recording();
+        counter_facade facade{std::make_unique<counter>()};
+        record(facade);
+        facade::master().stop();
+    }
+    const auto stats = facade::master().get_serialization_stats();
+    ASSERT_EQ(stats.enqueued, recorded_calls_number);
+    ASSERT_EQ(stats.processed, stats.enqueued);
+    ASSERT_EQ(stats.dropped, 0);
+    {
+        facade::master().start_playing();
+        counter_facade facade;
+        const auto mismatches = count_mismatches(facade);
+        facade::master().stop();
+        ASSERT_EQ(mismatches, 0);
+    }
+
+    // with a tiny queue that drops on overflow every call is either serialized or
+    // counted as dropped
+    facade::master().set_async_serialization(
+        true, 1, facade::utils::overflow_policy::drop);
+    {
+        facade::master().start_recording();
+        counter_facade facade{std::make_unique<counter>()};
+        record(facade);
+        facade::master().stop();
+    }
+    const auto drop_stats = facade::master().get_serialization_stats();
+    ASSERT_EQ(drop_stats.enqueued + drop_stats.dropped, recorded_calls_number);
+    ASSERT_EQ(drop_stats.processed, drop_stats.enqueued);
+    facade::master().set_async_serialization(false);
+}
+
+TEST(multithread, streamed_recording)
+{
+    using namespace test_multithread;
+    facade::master().set_streaming_recording(true, 4096, std::chrono::milliseconds{1});
+    {
+        facade::master().start_recording();
+        counter_facade facade{std::make_unique<counter>()};
+        record(facade);
+        facade::master().stop();
+    }
+    facade::master().set_streaming_recording(false);
+    {
+        facade::master().start_playing();
+        counter_facade facade;
+        const auto mismatches = count_mismatches(facade);
+        facade::master().stop();
+        ASSERT_EQ(mismatches, 0);
+    }
+}
+
+TEST(multithread, stop_waits_for_active_calls)
+{
+    using namespace test_multithread;
+    {
+        facade::master().start_recording();
+        auto impl = std::make_unique<slow_counter>();
+        auto& entered = impl->entered;
+        slow_counter_facade facade{std::move(impl)};
+        std::atomic_bool returned{false};
+        std::thread caller([&facade, &returned]() {
+            facade.slow_square(3);
+            returned = true;
+        });
+        while (!entered) std::this_thread::yield();
+        // the call started while recording, so it's completed and saved
+        facade::master().stop();
+        ASSERT_TRUE(returned);
+        caller.join();
+    }
+    {
+        facade::master().set_replay_time_factor(0.0);
+        facade::master().start_playing();
+        slow_counter_facade facade;
+        ASSERT_EQ(facade.slow_square(3), 9);
+        facade::master().stop();
+        facade::master().set_replay_time_factor(1.0);
+    }
+}
+
+TEST(multithread, one_facade_from_more_threads)
+{
+    using namespace test_multithread;
+    for (const int threads_num : {1, 2, 4, 8}) {
+        {
+            counter_facade facade{std::make_unique<counter>()};
+            ASSERT_EQ(count_mismatches(facade, threads_num), 0);
+        }
+        {
+            facade::master().start_recording();
+            counter_facade facade{std::make_unique<counter>()};
+            record(facade, threads_num);
+            facade::master().stop();
+        }
+        {
+            facade::master().start_playing();
+            counter_facade facade;
+            const auto mismatches = count_mismatches(facade, threads_num);
+            facade::master().stop();
+            ASSERT_EQ(mismatches, 0) << threads_num << " threads";
+        }
+    }
+}
+
+// a facade recording calls of short lived threads doesn't keep a buffer for each
+TEST(multithread, buffers_of_exited_threads_are_reused)
+{
+    using namespace test_multithread;
+    constexpr int rounds = 50;
+    facade::master().start_recording();
+    {
+        buffered_counter_facade facade{std::make_unique<counter>()};
+        for (int round = 0; round < rounds; ++round) {
+            run_threads([&facade, round](int thread_idx) {
+                facade.square(round * threads_number + thread_idx);
+            });
+        }
+        ASSERT_LE(facade.recording_buffers(), threads_number);
+    }
+    facade::master().stop();
+
+    facade::master().start_playing();
+    {
+        buffered_counter_facade facade;
+        for (int value = 0; value < rounds * threads_number; ++value) {
+            ASSERT_EQ(facade.square(value), value * value);
+        }
+        // the buffers are dropped once their calls are taken
+        facade::master().start_recording();
+        facade.set_impl(std::make_unique<counter>());
+        run_threads([&facade](int thread_idx) { facade.square(thread_idx); });
+        ASSERT_LE(facade.recording_buffers(), threads_number);
+        facade::master().stop();
+        ASSERT_EQ(facade.recording_buffers(), 0);
+    }
+}
+
+TEST(multithread, many_facades)
+{
+    using namespace test_multithread;
+    {
+        facade::master().start_recording();
+        const auto facades = make_counter_facades(true);
+        run_threads([&facades](int thread_idx) {
+            with_facade(*facades, thread_idx % counter_facades_num,
+                [thread_idx](auto& facade) { record_thread_calls(facade, thread_idx); });
+        });
+        facade::master().stop();
+    }
+    {
+        facade::master().start_playing();
+        const auto facades = make_counter_facades(false);
+        std::atomic_int mismatches{0};
+        run_threads([&](int thread_idx) {
+            with_facade(*facades, thread_idx % counter_facades_num, [&](auto& facade) {
+                mismatches += count_thread_mismatches(facade, thread_idx);
+            });
+        });
+        facade::master().stop();
+        ASSERT_EQ(mismatches, 0);
+    }
+}
+
+// threads replaying the same call share its results, every result is replayed
+// as many times as the others
+TEST(multithread, concurrent_replays_of_the_same_call)
+{
+    using namespace test_multithread;
+    constexpr int results_num = 10;
+    {
+        facade::master().start_recording();
+        sequence_facade facade{std::make_unique<sequence>()};
+        for (int idx = 0; idx < results_num; ++idx) facade.next();
+        facade::master().stop();
+    }
+    std::vector<std::map<int, int>> replayed(threads_number);
+    {
+        facade::master().start_playing();
+        sequence_facade facade;
+        run_threads([&](int thread_idx) {
+            for (int call = 0; call < calls_per_thread * results_num; ++call) {
+                ++replayed[thread_idx][facade.next()];
+            }
+        });
+        facade::master().stop();
+    }
+    std::map<int, int> total;
+    for (const auto& thread_replayed : replayed) {
+        for (const auto& [value, times] : thread_replayed) total[value] += times;
+    }
+    ASSERT_EQ(total.size(), results_num);
+    for (const auto& [value, times] : total) {
+        ASSERT_EQ(times, threads_number * calls_per_thread) << value;
+    }
+}
+
+TEST(multithread, one_master)
+{
+    using namespace test_multithread;
+    std::vector<const void*> masters(threads_number);
+    run_threads([&masters](int thread_idx) { masters[thread_idx] = &facade::master(); });
+    for (const auto* master : masters) ASSERT_EQ(master, &facade::master());
+}
+
+// the recordings of all the registered facades are saved and loaded by more I/O
+// workers, a recording that can't be loaded fails starting to play
+TEST(multithread, recordings_saved_and_loaded_in_parallel)
+{
+    using namespace test_multithread;
+    const size_t io_workers = facade::master().get_number_of_io_workers();
+    facade::master().set_number_of_io_workers(3);
+    {
+        facade::master().start_recording();
+        const auto facades = make_counter_facades(true);
+        for (size_t idx = 0; idx < counter_facades_num; ++idx) {
+            with_facade(*facades, idx, [idx](auto& facade) {
+                for (int value = 0; value < 10; ++value) {
+                    facade.square(value + static_cast<int>(idx));
+                }
+            });
+        }
+        // saved by the I/O workers while all the facades are alive
+        facade::master().stop();
+
+        facade::master().start_playing();
+        for (size_t idx = 0; idx < counter_facades_num; ++idx) {
+            with_facade(*facades, idx, [idx](auto& facade) {
+                for (int value = 0; value < 10; ++value) {
+                    const int argument = value + static_cast<int>(idx);
+                    ASSERT_EQ(facade.square(argument), argument * argument);
+                }
+            });
+        }
+        facade::master().stop();
+
+        std::filesystem::remove(facade::master().make_recording_path(
+            std::get<counter_facade_2>(*facades)));
+        ASSERT_THROW(facade::master().start_playing(), std::runtime_error);
+        facade::master().stop();
+    }
+    facade::master().set_number_of_io_workers(io_workers);
+}
+
+// facades of the same class share a recording file, saving them with more I/O
+// workers doesn't interleave their writes
+TEST(multithread, facades_sharing_a_recording_saved_in_parallel)
+{
+    using namespace test_multithread;
+    const size_t io_workers = facade::master().get_number_of_io_workers();
+    facade::master().set_number_of_io_workers(3);
+    {
+        facade::master().start_recording();
+        std::vector<std::unique_ptr<counter_facade_0>> facades;
+        for (size_t idx = 0; idx < 4; ++idx) {
+            facades.push_back(
+                std::make_unique<counter_facade_0>(std::make_unique<counter>()));
+            for (int value = 0; value < 100; ++value) facades.back()->square(value);
+        }
+        facade::master().stop();
+    }
+    {
+        facade::master().start_playing();
+        counter_facade_0 facade;
+        for (int value = 0; value < 100; ++value) {
+            ASSERT_EQ(facade.square(value), value * value);
+        }
+        facade::master().stop();
+    }
+    facade::master().set_number_of_io_workers(io_workers);
+}
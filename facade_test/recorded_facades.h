@@ -0,0 +1,119 @@
+#pragma once
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include <facade.h>
+
+// Helpers of the tests that record calls through a facade and replay them, most of
+// them run once with a facade recorded as JSON and once with its twin recorded in
+// the binary format
+namespace recorded_facades
+{
+    // the factor tells the results of different recordings apart
+    class scaler
+    {
+        int m_factor;
+        int m_calls{0};
+
+    public:
+        explicit scaler(int factor) : m_factor(factor) {}
+        int scale(int value) const { return value * m_factor; }
+        // returns another result every time
+        int next() { return ++m_calls * m_factor; }
+    };
+
+    class scaler_facade : public facade::facade<scaler>
+    {
+    public:
+        FACADE_CONSTRUCTOR(scaler_facade);
+        FACADE_METHOD(scale);
+        FACADE_METHOD(next);
+    };
+
+    class binary_scaler_facade
+        : public facade::facade<scaler, facade::binary_archive_policy>
+    {
+    public:
+        FACADE_CONSTRUCTOR(binary_scaler_facade);
+        FACADE_METHOD(scale);
+        FACADE_METHOD(next);
+    };
+
+    // the recording file of the facade class, must not be called while playing
+    template <typename t_facade>
+    std::filesystem::path recording_path()
+    {
+        t_facade facade;
+        return facade::master().make_recording_path(facade);
+    }
+
+    inline std::string read_recording(const std::filesystem::path& path)
+    {
+        std::ifstream ifs(path, std::ios::binary);
+        std::stringstream ss;
+        ss << ifs.rdbuf();
+        return ss.str();
+    }
+
+    // records the calls body makes through a facade with the implementation and
+    // returns the path of the recording
+    template <typename t_facade, typename t_impl, typename t_body>
+    std::filesystem::path record(std::unique_ptr<t_impl> impl, const t_body& body)
+    {
+        std::filesystem::path path;
+        facade::master().start_recording();
+        {
+            t_facade facade{std::move(impl)};
+            body(facade);
+            path = facade::master().make_recording_path(facade);
+        }
+        facade::master().stop();
+        return path;
+    }
+
+    // replays the calls body makes through a facade without an implementation
+    template <typename t_facade, typename t_body>
+    void replay(const t_body& body)
+    {
+        facade::master().start_playing();
+        {
+            t_facade facade;
+            body(facade);
+        }
+        facade::master().stop();
+    }
+
+    // Recordings are written to a new temporary directory for as long as it
+    // exists, it's removed with everything in it afterwards
+    class temporary_recording_directory
+    {
+        std::filesystem::path m_path;
+
+    public:
+        temporary_recording_directory()
+        {
+            std::random_device random;
+            m_path = std::filesystem::temp_directory_path() /
+                ("facade_test_" + std::to_string(random()));
+            std::filesystem::create_directories(m_path);
+            facade::master().set_recording_directory(m_path.string(), "");
+        }
+
+        temporary_recording_directory(const temporary_recording_directory&) = delete;
+        temporary_recording_directory& operator=(
+            const temporary_recording_directory&) = delete;
+
+        ~temporary_recording_directory()
+        {
+            facade::master().set_recording_directory(".", "");
+            std::error_code ec;
+            std::filesystem::remove_all(m_path, ec);
+        }
+
+        const std::filesystem::path& path() const { return m_path; }
+    };
+}  // namespace recorded_facades
@@ -0,0 +1,174 @@
+#include "facade.h"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace test_recording_policy
+{
+    class sensor
+    {
+        int m_reads{0};
+        int m_samples{0};
+
+    public:
+        int read() { return ++m_reads; }
+        int sample(int channel) { return channel * 100000 + ++m_samples; }
+    };
+
+    class sensor_facade : public facade::facade<sensor>
+    {
+    public:
+        FACADE_CONSTRUCTOR(sensor_facade);
+        FACADE_METHOD(read);
+        FACADE_RECORDING_POLICY(read, ::facade::recording_policy::every(10));
+        FACADE_METHOD(sample);
+    };
+
+    // values of the recorded results of a call in the recorded order, results are
+    // replayed in a cycle so the first value repeats after the last one
+    template <typename t_replay>
+    std::vector<int> replayed_values(size_t max_results, const t_replay& replay)
+    {
+        std::vector<int> values;
+        for (size_t idx = 0; idx < max_results + 1; ++idx) {
+            const int value = replay();
+            if (!values.empty() && value == values.front()) break;
+            values.push_back(value);
+        }
+        return values;
+    }
+
+    template <typename t_record, typename t_replay>
+    std::vector<int> record_and_replay(
+        size_t max_results, const t_record& record, const t_replay& replay)
+    {
+        facade::master().start_recording();
+        {
+            sensor_facade facade{std::make_unique<sensor>()};
+            record(facade);
+        }
+        facade::master().stop();
+
+        std::vector<int> values;
+        facade::master().start_playing();
+        {
+            sensor_facade facade;
+            values = replayed_values(max_results, [&]() { return replay(facade); });
+        }
+        facade::master().stop();
+        return values;
+    }
+}  // namespace test_recording_policy
+
+TEST(recording_policy, declared_one_in_n)
+{
+    using namespace test_recording_policy;
+    const auto values = record_and_replay(
+        100,
+        [](sensor_facade& facade) {
+            for (int idx = 0; idx < 100; ++idx) ASSERT_EQ(facade.read(), idx + 1);
+        },
+        [](sensor_facade& facade) { return facade.read(); });
+    ASSERT_EQ(values, (std::vector<int>{1, 11, 21, 31, 41, 51, 61, 71, 81, 91}));
+}
+
+TEST(recording_policy, result_caps)
+{
+    using namespace test_recording_policy;
+    const auto record = [](sensor_facade& facade) {
+        for (int idx = 0; idx < 1000; ++idx) {
+            facade.sample(1);
+            facade.sample(2);
+        }
+    };
+    const auto replay_first_channel = [](sensor_facade& facade) {
+        return facade.sample(1);
+    };
+
+    facade::master().set_recording_policy(
+        "sensor_facade", "sample", facade::recording_policy{}.keep_first(3));
+    auto values = record_and_replay(1000, record, replay_first_channel);
+    ASSERT_EQ(values, (std::vector<int>{100001, 100003, 100005}));
+
+    facade::master().set_recording_policy(
+        "sensor_facade", "sample", facade::recording_policy{}.keep_last(3));
+    values = record_and_replay(1000, record, replay_first_channel);
+    ASSERT_EQ(values, (std::vector<int>{101995, 101997, 101999}));
+
+    // the sample is spread over all the calls and keeps their order
+    facade::master().set_recording_policy(
+        "sensor_facade", "sample", facade::recording_policy{}.keep_sample(20));
+    values = record_and_replay(1000, record, replay_first_channel);
+    ASSERT_EQ(values.size(), 20);
+    ASSERT_TRUE(std::is_sorted(values.begin(), values.end()));
+    ASSERT_GT(values.back() - values.front(), 1000);
+
+    // the caps apply to every combination of arguments on its own
+    values = record_and_replay(
+        1000, record, [](sensor_facade& facade) { return facade.sample(2); });
+    ASSERT_EQ(values.size(), 20);
+    ASSERT_GE(values.front(), 200000);
+
+    facade::master().reset_recording_policy("sensor_facade", "sample");
+    values = record_and_replay(1000, record, replay_first_channel);
+    ASSERT_EQ(values.size(), 1000);
+}
+
+TEST(recording_policy, evicted_results_are_released)
+{
+    using namespace test_recording_policy;
+    const auto record = [](sensor_facade& facade) {
+        for (int idx = 0; idx < 20000; ++idx) facade.sample(1);
+    };
+    std::filesystem::path path;
+    const auto replay = [&path](sensor_facade& facade) {
+        path = facade::master().make_recording_path(facade);
+        return facade.sample(1);
+    };
+
+    facade::master().set_recording_policy(
+        "sensor_facade", "sample", facade::recording_policy{}.keep_last(3));
+    const auto values = record_and_replay(20000, record, replay);
+    facade::master().reset_recording_policy("sensor_facade", "sample");
+    ASSERT_EQ(values, (std::vector<int>{119998, 119999, 120000}));
+    // the payloads of 20000 results would take hundreds of kilobytes
+    ASSERT_LT(std::filesystem::file_size(path), 4096);
+}
+
+TEST(recording_policy, runtime_policy_overrides_declared_one)
+{
+    using namespace test_recording_policy;
+    const auto record = [](sensor_facade& facade) {
+        for (int idx = 0; idx < 2000; ++idx) facade.read();
+    };
+    const auto replay = [](sensor_facade& facade) { return facade.read(); };
+
+    facade::master().set_recording_policy(
+        "sensor_facade", "read", facade::recording_policy::sampled(0.5));
+    auto values = record_and_replay(2000, record, replay);
+    ASSERT_GT(values.size(), 800);
+    ASSERT_LT(values.size(), 1200);
+
+    facade::master().set_recording_policy(
+        "sensor_facade", "read", facade::recording_policy::sampled(0));
+    values = record_and_replay(2000, record, replay);
+    // nothing is recorded, the replay returns a default value
+    ASSERT_EQ(values, (std::vector<int>{0}));
+
+    facade::master().reset_recording_policy("sensor_facade", "read");
+    values = record_and_replay(2000, record, replay);
+    ASSERT_EQ(values.size(), 200);
+}
+
+TEST(recording_policy, invalid_policies_are_rejected)
+{
+    ASSERT_THROW(facade::master().set_recording_policy(
+                     "sensor_facade", "read", facade::recording_policy::every(0)),
+        std::invalid_argument);
+    ASSERT_THROW(facade::master().set_recording_policy(
+                     "sensor_facade", "read", facade::recording_policy::sampled(1.5)),
+        std::invalid_argument);
+}
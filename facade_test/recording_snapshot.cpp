@@ -0,0 +1,178 @@
+#include "facade.h"
+#include "recorded_facades.h"
+
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+#include <gtest/gtest.h>
+
+namespace test_recording_snapshot
+{
+    using namespace recorded_facades;
+
+    template <typename t_facade>
+    void record_scaled(int factor)
+    {
+        record<t_facade>(std::make_unique<scaler>(factor), [](t_facade& facade) {
+            for (int value = 0; value < 4; ++value) facade.scale(value);
+            for (int call = 0; call < 3; ++call) facade.next();
+        });
+    }
+
+    template <typename t_facade>
+    void expect_factor(t_facade& facade, int factor)
+    {
+        for (int value = 0; value < 4; ++value) {
+            ASSERT_EQ(facade.scale(value), value * factor) << value;
+        }
+    }
+
+    template <typename t_facade>
+    void replays_from_own_cursors()
+    {
+        record_scaled<t_facade>(10);
+        facade::master().start_playing();
+        {
+            t_facade first;
+            ASSERT_EQ(first.next(), 10);
+            ASSERT_EQ(first.next(), 20);
+            for (int facades = 0; facades < 100; ++facades) {
+                t_facade other;
+                expect_factor(other, 10);
+                ASSERT_EQ(other.next(), 10);
+            }
+            ASSERT_EQ(first.next(), 30);
+        }
+        facade::master().stop();
+    }
+
+    template <typename t_facade>
+    void modified_recordings_are_loaded_again()
+    {
+        const auto path = recording_path<t_facade>();
+        auto copy = path;
+        copy += ".x10";
+        record_scaled<t_facade>(10);
+        std::filesystem::copy_file(
+            path, copy, std::filesystem::copy_options::overwrite_existing);
+
+        // written by master
+        record_scaled<t_facade>(100);
+        facade::master().start_playing();
+        {
+            t_facade facade;
+            expect_factor(facade, 100);
+        }
+        facade::master().stop();
+
+        // written by someone else while the snapshot is cached
+        facade::master().start_playing();
+        {
+            t_facade facade;
+            expect_factor(facade, 100);
+        }
+        const auto modified = std::filesystem::last_write_time(path);
+        std::filesystem::copy_file(
+            copy, path, std::filesystem::copy_options::overwrite_existing);
+        std::filesystem::last_write_time(path, modified + std::chrono::seconds{1});
+        {
+            t_facade facade;
+            expect_factor(facade, 10);
+        }
+        facade::master().stop();
+        std::filesystem::remove(copy);
+    }
+
+    template <typename t_facade>
+    void saved_recordings_replace_mapped_ones()
+    {
+        record_scaled<t_facade>(10);
+        std::shared_ptr<facade::recording_snapshot> mapped;
+        facade::master().start_playing();
+        {
+            t_facade facade;
+            mapped =
+                static_cast<facade::facade_interface&>(facade).facade_share_snapshot();
+        }
+        facade::master().stop();
+
+        record_scaled<t_facade>(100);
+        facade::master().start_playing();
+        {
+            t_facade facade;
+            expect_factor(facade, 100);
+        }
+        {
+            t_facade facade;
+            auto& replaying = static_cast<facade::facade_interface&>(facade);
+            replaying.facade_clear();
+            ASSERT_TRUE(replaying.facade_replay_snapshot(mapped));
+            expect_factor(facade, 10);
+        }
+        facade::master().stop();
+    }
+}  // namespace test_recording_snapshot
+
+// facades constructed while playing share the recording, each of them replays
+// the results of a call from the first one
+TEST(recording_snapshot, facades_replay_from_their_own_cursors)
+{
+    using namespace test_recording_snapshot;
+    replays_from_own_cursors<scaler_facade>();
+    replays_from_own_cursors<binary_scaler_facade>();
+}
+
+TEST(recording_snapshot, modified_recordings_are_loaded_again)
+{
+    using namespace test_recording_snapshot;
+    modified_recordings_are_loaded_again<scaler_facade>();
+    modified_recordings_are_loaded_again<binary_scaler_facade>();
+}
+
+// a recording saved while the previous one is still mapped by a snapshot replaces
+// the file, the snapshot keeps replaying what it mapped
+TEST(recording_snapshot, saved_recordings_replace_mapped_ones)
+{
+    using namespace test_recording_snapshot;
+    saved_recordings_replace_mapped_ones<scaler_facade>();
+    saved_recordings_replace_mapped_ones<binary_scaler_facade>();
+}
+
+// a streamed recording doesn't truncate the file a snapshot still maps either
+TEST(recording_snapshot, streamed_recordings_replace_mapped_ones)
+{
+    using namespace test_recording_snapshot;
+    facade::master().set_streaming_recording(true);
+    saved_recordings_replace_mapped_ones<scaler_facade>();
+    saved_recordings_replace_mapped_ones<binary_scaler_facade>();
+    facade::master().set_streaming_recording(false);
+}
+
+// a facade that replayed a shared recording doesn't record into it, its calls are
+// recorded from scratch
+TEST(recording_snapshot, recording_after_replay_starts_from_scratch)
+{
+    using namespace test_recording_snapshot;
+    record_scaled<scaler_facade>(10);
+    facade::master().start_playing();
+    {
+        scaler_facade replayed;
+        expect_factor(replayed, 10);
+    }
+    scaler_facade facade{std::make_unique<scaler>(100)};
+    expect_factor(facade, 10);
+
+    facade::master().start_recording();
+    ASSERT_EQ(facade.scale(1), 100);
+    // the recording is saved by stop
+    facade::master().start_playing();
+    ASSERT_EQ(facade.scale(1), 100);
+    ASSERT_EQ(facade.scale(2), 0);
+    {
+        scaler_facade replayed;
+        ASSERT_EQ(replayed.scale(1), 100);
+    }
+    facade::master().stop();
+}
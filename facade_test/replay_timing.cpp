@@ -0,0 +1,154 @@
+#include "facade.h"
+
+#include <cmath>
+#include <limits>
+
+#include <gtest/gtest.h>
+
+namespace test_replay_timing
+{
+    constexpr auto recorded_duration = std::chrono::milliseconds{20};
+
+    class slow_service
+    {
+    public:
+        int request(int value) const
+        {
+            std::this_thread::sleep_for(recorded_duration);
+            return value + 1;
+        }
+    };
+
+    class slow_service_facade : public facade::facade<slow_service>
+    {
+    public:
+        FACADE_CONSTRUCTOR(slow_service_facade);
+        FACADE_METHOD(request);
+    };
+
+    constexpr auto ticks_interval = std::chrono::milliseconds{30};
+
+    class ticker
+    {
+        std::function<void(int)> m_tick_cbk;
+
+    public:
+        void register_tick_cbk(const std::function<void(int)>& cbk) { m_tick_cbk = cbk; }
+        void tick(int number)
+        {
+            if (m_tick_cbk) m_tick_cbk(number);
+        }
+    };
+
+    class ticker_facade : public facade::facade<ticker>
+    {
+    public:
+        FACADE_CONSTRUCTOR(ticker_facade);
+        FACADE_METHOD(tick);
+        FACADE_CALLBACK(tick_cbk, void, int);
+    };
+
+    template <typename t_body>
+    auto measure(const t_body& body)
+    {
+        const auto started = std::chrono::high_resolution_clock::now();
+        body();
+        return std::chrono::high_resolution_clock::now() - started;
+    }
+}  // namespace test_replay_timing
+
+TEST(replay_timing, precise_sleep)
+{
+    using namespace test_replay_timing;
+    for (const auto duration : {std::chrono::microseconds{50},
+             std::chrono::microseconds{300}, std::chrono::microseconds{1500}}) {
+        const auto elapsed =
+            measure([duration]() { facade::utils::precise_sleep_for(duration); });
+        ASSERT_GE(elapsed, duration);
+    }
+}
+
+TEST(replay_timing, time_factor)
+{
+    using namespace test_replay_timing;
+    {
+        facade::master().start_recording();
+        slow_service_facade facade{std::make_unique<slow_service>()};
+        ASSERT_EQ(facade.request(1), 2);
+        facade::master().stop();
+    }
+    {
+        facade::master().set_replay_time_factor(1.0);
+        facade::master().start_playing();
+        slow_service_facade facade;
+        const auto elapsed = measure([&facade]() { ASSERT_EQ(facade.request(1), 2); });
+        facade::master().stop();
+        ASSERT_GE(elapsed, recorded_duration);
+    }
+    {
+        facade::master().set_replay_time_factor(0.0);
+        facade::master().start_playing();
+        slow_service_facade facade;
+        const auto elapsed = measure([&facade]() { ASSERT_EQ(facade.request(1), 2); });
+        facade::master().stop();
+        ASSERT_LT(elapsed, recorded_duration);
+    }
+    facade::master().set_replay_time_factor(1.0);
+    ASSERT_EQ(facade::master().scale_replay_time(facade::t_duration{100}),
+        facade::t_duration{100});
+    facade::master().set_replay_time_factor(0.5);
+    ASSERT_EQ(facade::master().scale_replay_time(facade::t_duration{100}),
+        facade::t_duration{50});
+    facade::master().set_replay_time_factor(1.0);
+}
+
+TEST(replay_timing, invalid_time_factors)
+{
+    facade::master().set_replay_time_factor(0.5);
+    ASSERT_THROW(facade::master().set_replay_time_factor(std::nan("")),
+        std::invalid_argument);
+    ASSERT_THROW(facade::master().set_replay_time_factor(
+                     std::numeric_limits<double>::infinity()),
+        std::invalid_argument);
+    ASSERT_THROW(facade::master().set_replay_time_factor(-1.0), std::invalid_argument);
+    ASSERT_EQ(facade::master().get_replay_time_factor(), 0.5);
+    facade::master().set_replay_time_factor(1.0);
+}
+
+TEST(replay_timing, callback_deadlines)
+{
+    using namespace test_replay_timing;
+    {
+        facade::master().start_recording();
+        ticker_facade facade{std::make_unique<ticker>()};
+        facade.rewire_callbacks([](ticker& impl, ticker_facade& facade) {
+            facade.register_callback_tick_cbk([](int) {});
+            impl.register_tick_cbk(facade.get_callback_tick_cbk());
+        });
+        // leaves time for the replaying facade to register its callback
+        std::this_thread::sleep_for(ticks_interval);
+        facade.tick(1);
+        std::this_thread::sleep_for(ticks_interval);
+        facade.tick(2);
+        facade::master().stop();
+    }
+    {
+        std::mutex mtx;
+        std::vector<std::chrono::high_resolution_clock::time_point> ticks;
+        facade::master().start_playing();
+        ticker_facade facade;
+        facade.register_callback_tick_cbk([&](int) {
+            std::lock_guard<std::mutex> lg(mtx);
+            ticks.push_back(std::chrono::high_resolution_clock::now());
+        });
+        facade::master().wait_all_pending_callbacks_replayed();
+        facade::master().stop();
+
+        ASSERT_EQ(ticks.size(), 2);
+        ASSERT_GE(ticks[1] - ticks[0], ticks_interval / 2);
+        const auto lateness = facade::master().get_callback_lateness();
+        ASSERT_EQ(lateness.callbacks, 2);
+        ASSERT_LE(lateness.mean(), lateness.max);
+        ASSERT_LT(lateness.max, ticks_interval);
+    }
+}
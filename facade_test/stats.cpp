@@ -0,0 +1,172 @@
+#include "facade.h"
+
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace test_stats
+{
+    class meter
+    {
+    public:
+        int scale(int value) const { return value * 10; }
+        int offset(int value) const { return value + 1; }
+    };
+
+    class meter_facade : public facade::facade<meter>
+    {
+    public:
+        FACADE_CONSTRUCTOR(meter_facade);
+        FACADE_METHOD(scale);
+        FACADE_METHOD(offset);
+        FACADE_RECORDING_POLICY(offset, ::facade::recording_policy::every(4));
+    };
+
+    // instances of the class are named by their constructor
+    class named_meter_facade : public facade::facade<meter>
+    {
+    public:
+        using t_this_type = named_meter_facade;
+        named_meter_facade(std::string name, std::unique_ptr<meter> ptr)
+            : facade(std::move(name), false)
+        {
+            m_impl = ptr.release();
+            internal_register();
+        }
+        ~named_meter_facade()
+        {
+            internal_unregister();
+            delete m_impl;
+        }
+        FACADE_METHOD(scale);
+    };
+
+    void record_calls(int values, int repeats)
+    {
+        facade::master().start_recording();
+        {
+            meter_facade facade{std::make_unique<meter>()};
+            for (int repeat = 0; repeat < repeats; ++repeat) {
+                for (int value = 0; value < values; ++value) {
+                    ASSERT_EQ(facade.scale(value), value * 10);
+                    ASSERT_EQ(facade.offset(value), value + 1);
+                }
+            }
+        }
+        facade::master().stop();
+    }
+
+    void restore_log_message_callback()
+    {
+        facade::master().set_log_message_callback(
+            [](facade::log_message_level, const std::string& msg) {
+                std::cout << msg << std::endl;
+            });
+    }
+}  // namespace test_stats
+
+TEST(stats, recorded_and_replayed_calls_are_counted)
+{
+    using namespace test_stats;
+    facade::master().set_stats_collection(true);
+    for (const bool async : {false, true}) {
+        facade::master().set_async_serialization(async);
+        record_calls(10, 4);
+        facade::master().set_async_serialization(false);
+
+        auto stats = facade::master().get_stats();
+        const auto* scale = stats.find("meter_facade", "scale");
+        ASSERT_NE(scale, nullptr);
+        ASSERT_EQ(scale->calls, 40);
+        ASSERT_EQ(scale->recorded, 40);
+        ASSERT_EQ(scale->hits + scale->misses, 0);
+        ASSERT_GT(scale->bytes_serialized, 0);
+        ASSERT_GT(scale->serialization_ns, 0);
+        ASSERT_GT(scale->total_ns, 0);
+        // calls sampled out by the declared policy are passed through
+        const auto* offset = stats.find("meter_facade", "offset");
+        ASSERT_NE(offset, nullptr);
+        ASSERT_EQ(offset->calls, 40);
+        ASSERT_EQ(offset->recorded, 10);
+    }
+
+    facade::master().start_playing();
+    {
+        meter_facade facade;
+        for (int value = 0; value < 10; ++value) {
+            ASSERT_EQ(facade.scale(value), value * 10);
+        }
+        // never recorded, it returns a default value
+        ASSERT_EQ(facade.scale(42), 0);
+    }
+    facade::master().stop();
+    facade::master().set_stats_collection(false);
+
+    const auto stats = facade::master().get_stats();
+    const auto* scale = stats.find("meter_facade", "scale");
+    ASSERT_NE(scale, nullptr);
+    ASSERT_EQ(scale->calls, 11);
+    ASSERT_EQ(scale->hits, 10);
+    ASSERT_EQ(scale->misses, 1);
+    ASSERT_EQ(scale->recorded, 0);
+    ASSERT_GE(scale->total_ns, scale->decoding_ns + scale->hashing_ns);
+    // methods without calls are left out
+    ASSERT_EQ(stats.find("meter_facade", "offset"), nullptr);
+}
+
+TEST(stats, nothing_is_counted_unless_enabled)
+{
+    using namespace test_stats;
+    facade::master().set_stats_collection(false);
+    record_calls(10, 1);
+    ASSERT_TRUE(facade::master().get_stats().methods.empty());
+}
+
+TEST(stats, dumped_on_stop)
+{
+    using namespace test_stats;
+    std::string dumped;
+    facade::master().set_log_message_callback(
+        [&dumped](facade::log_message_level level, const std::string& msg) {
+            if (level == facade::log_message_level::info) dumped += msg;
+        });
+    facade::master().set_stats_collection(true, true);
+    record_calls(10, 2);
+    facade::master().set_stats_collection(false);
+    restore_log_message_callback();
+
+    ASSERT_NE(dumped.find("meter_facade.scale calls=20 recorded=20"), std::string::npos)
+        << dumped;
+    ASSERT_NE(dumped.find("serializer"), std::string::npos) << dumped;
+}
+
+TEST(stats, facades_of_one_class_are_counted_by_name)
+{
+    using namespace test_stats;
+    std::vector<std::filesystem::path> paths;
+    facade::master().set_stats_collection(true);
+    facade::master().start_recording();
+    {
+        named_meter_facade first{"first_meter_facade", std::make_unique<meter>()};
+        named_meter_facade second{"second_meter_facade", std::make_unique<meter>()};
+        for (int value = 0; value < 3; ++value) first.scale(value);
+        for (int value = 0; value < 5; ++value) second.scale(value);
+        paths.push_back(facade::master().make_recording_path(first));
+        paths.push_back(facade::master().make_recording_path(second));
+    }
+    facade::master().stop();
+    facade::master().set_stats_collection(false);
+    for (const auto& path : paths) std::filesystem::remove(path);
+
+    const auto stats = facade::master().get_stats();
+    const auto* first = stats.find("first_meter_facade", "scale");
+    const auto* second = stats.find("second_meter_facade", "scale");
+    ASSERT_NE(first, nullptr);
+    ASSERT_NE(second, nullptr);
+    ASSERT_EQ(first->calls, 3);
+    ASSERT_EQ(second->calls, 5);
+}
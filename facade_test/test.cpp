@@ -1,4 +1,5 @@
 ﻿#include "facade.h"
+#include "recorded_facades.h"
 
 #include <iostream>
 
@@ -160,12 +161,17 @@ namespace test_classes
     ASSERT_EQ(A.method(__VA_ARGS__), B.method(__VA_ARGS__)) \
         << #method " result mismatched";
 
-void compare_result(test_classes::a_class_facade& facade, test_classes::a_class& original)
+// Counters have to be reset before callbacks are registered, a replaying facade
+// may invoke the callbacks as soon as they are registered
+void reset_callback_counters()
 {
     test_classes::g_input_callback_times_called = 0;
     test_classes::g_input_output_callback_times_called = 0;
     test_classes::g_no_input_callback_times_called = 0;
+}
 
+void compare_result(test_classes::a_class_facade& facade, test_classes::a_class& original)
+{
     facade.no_input_no_return_function();
 
     do_compare_results(facade, original, no_input_function);
@@ -203,6 +209,7 @@ TEST(basic, compare_results)
         auto impl = std::make_unique<a_class>();
         a_class_facade facade{std::move(impl)};
 
+        reset_callback_counters();
         facade.rewire_callbacks([](a_class& impl, a_class_facade& facade) {
             facade.register_callback_input_function_cbk(input_callback);
             facade.register_callback_input_output_function_cbk(input_output_callback);
@@ -224,6 +231,7 @@ TEST(basic, compare_results)
         test_classes::a_class_facade facade;
         test_classes::a_class original;
 
+        reset_callback_counters();
         facade.register_callback_input_function_cbk(input_callback);
         facade.register_callback_input_output_function_cbk(input_output_callback);
         facade.register_callback_no_input_function_cbk(no_input_callback);
@@ -524,5 +532,7 @@ int main(int argc, char** argv)
             std::cout << msg << std::endl;
         });
 
+    // the recordings of the tests are removed once they are done
+    const recorded_facades::temporary_recording_directory recordings;
     return RUN_ALL_TESTS();
 }
@@ -0,0 +1,331 @@
+#include "worker_pool.h"
+
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace test_worker_pool
+{
+    // The allocation functions are replaced for the whole test binary, they only
+    // count allocations while an allocation_counter exists
+    std::atomic_bool count_allocations{false};
+    std::atomic<size_t> allocations{0};
+
+    void* allocate(size_t size, size_t alignment = 0)
+    {
+        if (count_allocations) ++allocations;
+        if (size == 0) size = 1;
+        void* ptr = nullptr;
+        if (alignment == 0) {
+            ptr = std::malloc(size);
+        } else {
+#if defined(_WIN32)
+            ptr = _aligned_malloc(size, alignment);
+#else
+            // the size of an aligned allocation is a multiple of the alignment
+            const size_t aligned_size = (size + alignment - 1) / alignment * alignment;
+            ptr = std::aligned_alloc(alignment, aligned_size);
+#endif
+        }
+        if (!ptr) throw std::bad_alloc{};
+        return ptr;
+    }
+
+    void deallocate(void* ptr, [[maybe_unused]] bool aligned) noexcept
+    {
+#if defined(_WIN32)
+        if (aligned) {
+            _aligned_free(ptr);
+            return;
+        }
+#endif
+        std::free(ptr);
+    }
+
+    // counts the allocations made by any thread while it exists
+    class allocation_counter
+    {
+    public:
+        allocation_counter()
+        {
+            allocations = 0;
+            count_allocations = true;
+        }
+        ~allocation_counter() { count_allocations = false; }
+
+        allocation_counter(const allocation_counter&) = delete;
+        allocation_counter& operator=(const allocation_counter&) = delete;
+
+        size_t counted() const { return allocations; }
+    };
+}  // namespace test_worker_pool
+
+void* operator new(size_t size) { return test_worker_pool::allocate(size); }
+void* operator new[](size_t size) { return test_worker_pool::allocate(size); }
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    return test_worker_pool::allocate(size, static_cast<size_t>(alignment));
+}
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    return test_worker_pool::allocate(size, static_cast<size_t>(alignment));
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    try {
+        return test_worker_pool::allocate(size);
+    } catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    try {
+        return test_worker_pool::allocate(size);
+    } catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void operator delete(void* ptr) noexcept { test_worker_pool::deallocate(ptr, false); }
+void operator delete[](void* ptr) noexcept { test_worker_pool::deallocate(ptr, false); }
+void operator delete(void* ptr, size_t) noexcept
+{
+    test_worker_pool::deallocate(ptr, false);
+}
+void operator delete[](void* ptr, size_t) noexcept
+{
+    test_worker_pool::deallocate(ptr, false);
+}
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+    test_worker_pool::deallocate(ptr, true);
+}
+void operator delete[](void* ptr, std::align_val_t) noexcept
+{
+    test_worker_pool::deallocate(ptr, true);
+}
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept
+{
+    test_worker_pool::deallocate(ptr, true);
+}
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept
+{
+    test_worker_pool::deallocate(ptr, true);
+}
+
+TEST(worker_pool, task_callables)
+{
+    using facade::utils::task;
+    int calls = 0;
+
+    // move-only callables are accepted
+    auto owned = std::make_unique<int>(1);
+    task small{[&calls, owned = std::move(owned)]() { calls += *owned; }};
+    // doesn't fit into the task, stored in a slab block
+    std::array<int, 32> medium_payload{};
+    medium_payload[0] = 10;
+    task medium{[&calls, medium_payload]() { calls += medium_payload[0]; }};
+    // doesn't fit into a slab block either
+    std::array<int, 256> large_payload{};
+    large_payload[0] = 100;
+    task large{[&calls, large_payload]() { calls += large_payload[0]; }};
+
+    task moved{std::move(small)};
+    ASSERT_FALSE(small);
+    std::vector<task> tasks;
+    tasks.push_back(std::move(moved));
+    tasks.push_back(std::move(medium));
+    tasks.push_back(std::move(large));
+    for (auto& each : tasks) each();
+    ASSERT_EQ(calls, 111);
+
+    tasks[0] = std::move(tasks[2]);
+    tasks[0]();
+    ASSERT_EQ(calls, 211);
+    tasks[1] = nullptr;
+    ASSERT_FALSE(tasks[1]);
+}
+
+TEST(worker_pool, post_doesnt_allocate)
+{
+    using namespace test_worker_pool;
+    constexpr size_t tasks = 10000;
+    facade::utils::worker_pool pool{4};
+    std::atomic<size_t> completed{0};
+    // the tasks queued before the pool is started grow the queues to the size
+    // they need when the same tasks are posted to a running pool
+    for (size_t idx = 0; idx < tasks; ++idx) {
+        pool.post([&completed]() { ++completed; });
+    }
+    pool.start();
+    pool.wait_completion();
+
+    size_t counted = 0;
+    {
+        const allocation_counter counter;
+        for (size_t idx = 0; idx < tasks; ++idx) {
+            pool.post([&completed]() { ++completed; });
+        }
+        pool.wait_completion();
+        counted = counter.counted();
+    }
+    pool.stop();
+
+    ASSERT_EQ(completed, 2 * tasks);
+    ASSERT_EQ(counted, 0);
+}
+
+TEST(worker_pool, single_worker_keeps_order)
+{
+    facade::utils::worker_pool pool{1};
+    pool.start();
+    std::vector<int> order;
+    for (int idx = 0; idx < 1000; ++idx) {
+        pool.submit([&order, idx]() { order.push_back(idx); });
+    }
+    pool.wait_completion();
+    pool.stop();
+
+    ASSERT_EQ(order.size(), 1000);
+    for (int idx = 0; idx < 1000; ++idx) ASSERT_EQ(order[idx], idx);
+}
+
+TEST(worker_pool, nested_submission)
+{
+    facade::utils::worker_pool pool{4};
+    pool.start();
+    std::atomic_int completed{0};
+    constexpr int parents = 100;
+    constexpr int children = 10;
+    for (int parent = 0; parent < parents; ++parent) {
+        pool.submit([&pool, &completed]() {
+            for (int child = 0; child < children; ++child) {
+                pool.submit([&completed]() { ++completed; });
+            }
+            ++completed;
+        });
+    }
+    pool.wait_completion();
+    ASSERT_EQ(completed, parents * (children + 1));
+    ASSERT_FALSE(pool.has_work());
+    pool.stop();
+}
+
+TEST(worker_pool, results_and_restart)
+{
+    facade::utils::worker_pool pool{8};
+    for (int round = 0; round < 3; ++round) {
+        pool.start();
+        std::vector<std::future<int>> results;
+        for (int idx = 0; idx < 256; ++idx) {
+            results.push_back(pool.submit([](int value) { return value * 2; }, idx));
+        }
+        for (int idx = 0; idx < 256; ++idx) ASSERT_EQ(results[idx].get(), idx * 2);
+        pool.stop();
+    }
+
+    // a reassigned pool drops its queued tasks, tasks submitted to a stopped pool
+    // are run once it's started
+    std::atomic_int completed{0};
+    pool.submit([&completed]() { ++completed; });
+    pool = facade::utils::worker_pool{2};
+    pool.submit([&completed]() { ++completed; });
+    pool.start();
+    pool.wait_completion();
+    pool.stop();
+    ASSERT_EQ(completed, 1);
+}
+
+#if defined(__linux__)
+TEST(worker_pool, thread_settings)
+{
+    struct placement
+    {
+        std::string name;
+        bool only_pinned_cpu;
+        int nice;
+    };
+
+    // the first CPU the test may run on, the cpuset of the process can exclude 0
+    cpu_set_t allowed;
+    ASSERT_EQ(sched_getaffinity(0, sizeof(allowed), &allowed), 0);
+    size_t pinned = 0;
+    while (!CPU_ISSET(pinned, &allowed)) ++pinned;
+
+    facade::utils::thread_settings settings{"test-worker"};
+    settings.cpus = {pinned};
+    settings.nice = 5;
+    std::atomic_int errors{0};
+    settings.report_error = [&errors](const std::string&) { ++errors; };
+
+    facade::utils::worker_pool pool{2};
+    pool.set_thread_settings(settings);
+    pool.start();
+    std::vector<std::future<placement>> placements;
+    for (int idx = 0; idx < 8; ++idx) {
+        placements.push_back(pool.submit([pinned]() {
+            placement result;
+            char name[16] = {};
+            pthread_getname_np(pthread_self(), name, sizeof(name));
+            result.name = name;
+            cpu_set_t cpus;
+            sched_getaffinity(0, sizeof(cpus), &cpus);
+            result.only_pinned_cpu = CPU_COUNT(&cpus) == 1 && CPU_ISSET(pinned, &cpus);
+            result.nice = getpriority(PRIO_PROCESS, 0);
+            return result;
+        }));
+    }
+    for (auto& future : placements) {
+        const auto result = future.get();
+        ASSERT_TRUE(result.name == "test-worker0" || result.name == "test-worker1");
+        ASSERT_TRUE(result.only_pinned_cpu);
+        ASSERT_EQ(result.nice, 5);
+    }
+    pool.stop();
+    ASSERT_EQ(errors, 0);
+}
+#endif
+
+#if defined(__linux__)
+// CPUs that don't fit in a cpu_set_t are reported and skipped, the affinity isn't
+// changed if none of the CPUs is left
+TEST(worker_pool, out_of_range_cpus)
+{
+    cpu_set_t allowed;
+    ASSERT_EQ(sched_getaffinity(0, sizeof(allowed), &allowed), 0);
+    size_t pinned = 0;
+    while (!CPU_ISSET(pinned, &allowed)) ++pinned;
+
+    const auto apply = [](std::vector<size_t> cpus) {
+        facade::utils::thread_settings settings;
+        settings.cpus = std::move(cpus);
+        int errors = 0;
+        settings.report_error = [&errors](const std::string&) { ++errors; };
+        int allowed_cpus = 0;
+        std::thread thread{[&]() {
+            facade::utils::apply_thread_settings(settings);
+            cpu_set_t cpus;
+            sched_getaffinity(0, sizeof(cpus), &cpus);
+            allowed_cpus = CPU_COUNT(&cpus);
+        }};
+        thread.join();
+        return std::make_pair(errors, allowed_cpus);
+    };
+
+    const auto [errors, allowed_cpus] = apply({pinned, CPU_SETSIZE, CPU_SETSIZE + 1});
+    ASSERT_EQ(errors, 2);
+    ASSERT_EQ(allowed_cpus, 1);
+
+    const auto [none_errors, none_allowed_cpus] = apply({CPU_SETSIZE});
+    ASSERT_EQ(none_errors, 2);
+    ASSERT_EQ(none_allowed_cpus, CPU_COUNT(&allowed));
+}
+#endif
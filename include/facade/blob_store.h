@@ -0,0 +1,95 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "flat_map.h"
+#include "hash.h"
+
+namespace facade
+{
+    // Recorded argument and result payloads are referenced by the id of a blob,
+    // id 0 is the empty payload and is never stored
+    using t_blob_id = uint32_t;
+
+    // Payloads of a recording interned by their content. A getter returning the
+    // same value on every call is stored once no matter how many results reference
+    // it. Blobs are either owned by the store or are views into a mapped recording
+    // that outlives the store's use, they are never removed one by one. The store
+    // is not synchronized, it's changed under the lock of the owning facade
+    class blob_store
+    {
+        // stable addresses, the views point into the strings
+        std::deque<std::string> m_owned;
+        std::vector<std::string_view> m_blobs;
+        // content hash to the first blob with that hash, a blob whose hash collides
+        // with another content is stored again rather than compared in a chain
+        utils::flat_map<uint64_t, t_blob_id> m_by_hash;
+        size_t m_bytes{0};
+
+        t_blob_id append(std::string_view blob)
+        {
+            m_blobs.push_back(blob);
+            m_bytes += blob.size();
+            return static_cast<t_blob_id>(m_blobs.size());
+        }
+
+    public:
+        // returns the id of a blob with the same content, storing it if it's new
+        t_blob_id intern(std::string&& payload)
+        {
+            if (payload.empty()) return 0;
+            const uint64_t hash = utils::hash64(payload);
+            auto&& [found, inserted] = m_by_hash.try_emplace(hash, 0);
+            if (!inserted && get(*found) == payload) return *found;
+
+            m_owned.emplace_back(std::move(payload));
+            const t_blob_id id = append(m_owned.back());
+            if (inserted) *found = id;
+            return id;
+        }
+
+        // stores the blob under the next id without looking for duplicates, used
+        // when a saved store is loaded so the ids stay as they were saved. Payloads
+        // interned afterwards are deduplicated against the loaded blobs
+        t_blob_id add(std::string&& payload)
+        {
+            m_owned.emplace_back(std::move(payload));
+            return add_view(m_owned.back());
+        }
+
+        // stores a view of memory the caller keeps alive, under the next id
+        t_blob_id add_view(std::string_view blob)
+        {
+            const t_blob_id id = append(blob);
+            m_by_hash.try_emplace(utils::hash64(blob.data(), blob.size()), id);
+            return id;
+        }
+
+        std::string_view get(t_blob_id id) const
+        {
+            if (id == 0) return {};
+            if (id > m_blobs.size()) {
+                throw std::runtime_error{"a recording references an unknown blob"};
+            }
+            return m_blobs[id - 1];
+        }
+
+        // number of stored blobs, ids go from 1 to size()
+        size_t size() const { return m_blobs.size(); }
+        // bytes of the stored blobs
+        size_t bytes() const { return m_bytes; }
+        bool empty() const { return m_blobs.empty(); }
+
+        void clear()
+        {
+            m_blobs.clear();
+            m_owned.clear();
+            m_by_hash.clear();
+            m_bytes = 0;
+        }
+    };
+}  // namespace facade
@@ -0,0 +1,156 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "lz4.h"
+
+namespace facade
+{
+    // Layout of a compressed recording:
+    //
+    //   [compressed header][block entry]...[block]...
+    //
+    // The recording is cut into blocks of the same raw size, the last one may be
+    // shorter, and every block is compressed on its own so blocks can be
+    // decompressed independently and in any order. A block that doesn't shrink is
+    // stored as it is. The recording inside can be in any of the formats from
+    // recording.h, it's decompressed before it's loaded
+    namespace recording_format
+    {
+        constexpr const char compressed_magic[8] = {'f', 'a', 'c', 'l', 'z', '4', 0, 1};
+
+        struct compressed_header
+        {
+            char magic[sizeof(compressed_magic)];
+            uint64_t raw_size;
+            uint64_t block_size;
+            uint64_t blocks;
+        };
+
+        struct compressed_block
+        {
+            // from the beginning of the file
+            uint64_t offset;
+            uint64_t size;
+        };
+
+        inline bool is_compressed(const char* data, size_t size)
+        {
+            return size >= sizeof(compressed_magic) &&
+                std::memcmp(data, compressed_magic, sizeof(compressed_magic)) == 0;
+        }
+
+        inline void write_compressed(
+            std::ostream& stream, std::string_view recording, size_t block_size)
+        {
+            if (block_size == 0) throw std::invalid_argument{"block size can't be 0"};
+            const size_t blocks_num = (recording.size() + block_size - 1) / block_size;
+            compressed_header header{};
+            std::memcpy(header.magic, compressed_magic, sizeof(compressed_magic));
+            header.raw_size = recording.size();
+            header.block_size = block_size;
+            header.blocks = blocks_num;
+
+            std::vector<compressed_block> blocks(blocks_num);
+            std::string compressed;
+            uint64_t offset = sizeof(header) + blocks_num * sizeof(compressed_block);
+            for (size_t idx = 0; idx < blocks_num; ++idx) {
+                const auto raw = recording.substr(idx * block_size, block_size);
+                const size_t written = compressed.size();
+                compressed.resize(written + utils::lz4::compress_bound(raw.size()));
+                size_t size = utils::lz4::compress(
+                    raw.data(), raw.size(), compressed.data() + written);
+                if (size >= raw.size()) {
+                    std::memcpy(compressed.data() + written, raw.data(), raw.size());
+                    size = raw.size();
+                }
+                compressed.resize(written + size);
+                blocks[idx] = {offset, size};
+                offset += size;
+            }
+
+            stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            stream.write(reinterpret_cast<const char*>(blocks.data()),
+                static_cast<std::streamsize>(blocks_num * sizeof(compressed_block)));
+            stream.write(
+                compressed.data(), static_cast<std::streamsize>(compressed.size()));
+            stream.flush();
+        }
+
+        // A compressed recording in memory, checked when it's constructed
+        class compressed_view
+        {
+            const char* m_data;
+            compressed_header m_header;
+            std::vector<compressed_block> m_blocks;
+
+            [[noreturn]] static void fail(const char* what)
+            {
+                throw std::runtime_error{
+                    std::string{"a compressed recording is corrupted: "} + what};
+            }
+
+        public:
+            compressed_view(const char* data, size_t size) : m_data(data)
+            {
+                if (!is_compressed(data, size) || size < sizeof(m_header)) {
+                    fail("the header is missing");
+                }
+                std::memcpy(&m_header, data, sizeof(m_header));
+                const uint64_t max_blocks =
+                    (size - sizeof(m_header)) / sizeof(compressed_block);
+                // lz4 can't shrink data more than 255 times
+                if (m_header.block_size == 0 || m_header.raw_size / 255 > size ||
+                    m_header.blocks > max_blocks ||
+                    m_header.blocks != (m_header.raw_size + m_header.block_size - 1) /
+                            m_header.block_size) {
+                    fail("the header is invalid");
+                }
+                m_blocks.resize(static_cast<size_t>(m_header.blocks));
+                std::memcpy(m_blocks.data(), data + sizeof(m_header),
+                    m_blocks.size() * sizeof(compressed_block));
+                for (const auto& block : m_blocks) {
+                    if (block.offset > size || block.size > size - block.offset) {
+                        fail("a block is out of the file bounds");
+                    }
+                }
+            }
+
+            size_t raw_size() const { return static_cast<size_t>(m_header.raw_size); }
+            size_t blocks() const { return m_blocks.size(); }
+
+            // decompresses the block to its place in the raw recording, blocks can be
+            // decompressed concurrently
+            void decompress_block(size_t index, char* recording) const
+            {
+                const auto& block = m_blocks.at(index);
+                const auto block_size = static_cast<size_t>(m_header.block_size);
+                const size_t raw_offset = index * block_size;
+                const size_t block_raw_size =
+                    std::min(block_size, raw_size() - raw_offset);
+                const char* data = m_data + block.offset;
+                if (block.size == block_raw_size) {
+                    std::memcpy(recording + raw_offset, data, block_raw_size);
+                } else if (!utils::lz4::decompress(data, static_cast<size_t>(block.size),
+                               recording + raw_offset, block_raw_size)) {
+                    fail("a block can't be decompressed");
+                }
+            }
+
+            std::string decompress() const
+            {
+                std::string recording(raw_size(), '\0');
+                for (size_t idx = 0; idx < blocks(); ++idx) {
+                    decompress_block(idx, recording.data());
+                }
+                return recording;
+            }
+        };
+    }  // namespace recording_format
+}  // namespace facade
@@ -1,34 +1,51 @@
 ﻿#ifndef FACADE_H
 #define FACADE_H
 #pragma once
+#include <algorithm>
 #include <any>
+#include <atomic>
 #include <chrono>
+#include <cstring>
 #include <fstream>
 #include <functional>
+#include <iterator>
+#include <limits>
 #include <list>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <sstream>
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <type_traits>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include "flat_map.h"
+#include "hash.h"
 #include "master.h"
+#include "recording.h"
+#include "recording_policy.h"
+#include "stats.h"
 #include "utils.h"
 
+#include <cereal/archives/binary.hpp>
 #include <cereal/archives/json.hpp>
 #include <cereal/cereal.hpp>
 #include <cereal/types/list.hpp>
 #include <cereal/types/map.hpp>
+#include <cereal/types/string.hpp>
 #include <cereal/types/vector.hpp>
 
-#include <algorithm/md5.hpp>  // digestcpp
-
-#define FACADE_CHECK_OPTIONAL_METHODS(_NAME)      \
-private:                                          \
-    FACADE_CREATE_MEMBER_CHECK(filter_##_NAME);   \
-    FACADE_CREATE_MEMBER_CHECK(override_##_NAME); \
-                                                  \
+#define FACADE_CHECK_OPTIONAL_METHODS(_NAME)              \
+private:                                                  \
+    FACADE_CREATE_MEMBER_CHECK(filter_##_NAME);           \
+    FACADE_CREATE_MEMBER_CHECK(override_##_NAME);         \
+    FACADE_CREATE_MEMBER_CHECK(recording_policy_##_NAME); \
+                                                          \
 public:
 
 #define FACADE_METHOD(_NAME)                                                             \
@@ -37,8 +54,15 @@ public:
     auto _NAME(t_args&&... args)                                                         \
     {                                                                                    \
         using t_ret = decltype(m_impl->_NAME(args...));                                  \
+        using t_result = typename std::decay<t_ret>::type;                               \
+        if (is_passing_through()) {                                                      \
+            /* fast path, no type erasure and no allocations */                          \
+            if (!m_impl) return t_result();                                              \
+            return t_result(m_impl->_NAME(args...));                                     \
+        }                                                                                \
         using t_method = t_ret(t_args...);                                               \
-        using t_filter_and_record = void(std::string&, t_args...);                       \
+        using t_filter_and_record =                                                      \
+            void(std::string&, ::facade::t_call_key*, t_args...);                        \
         std::function method{                                                            \
             [this](t_args&&... args) -> t_ret { return m_impl->_NAME(args...); }};       \
         std::function<t_method> overrider;                                               \
@@ -55,14 +79,24 @@ public:
                 auto filter_binder = [this](auto&... args) -> t_ret {                    \
                     return filter_##_NAME(args...);                                      \
                 };                                                                       \
-                filter_and_record = [filter_binder](                                     \
-                                        std::string& recording, auto&&... args) {        \
-                    ::facade::filter_args_and_record(filter_binder, recording, args...); \
+                filter_and_record = [filter_binder](std::string& recording,              \
+                                        ::facade::t_call_key* key, auto&&... args) {     \
+                    ::facade::filter_args_and_record<t_archive_policy>(                  \
+                        filter_binder, recording, key, args...);                         \
                 };                                                                       \
             }                                                                            \
         }                                                                                \
-        ::facade::function_call_context ctx{#_NAME, false, std::move(method),            \
+        constexpr auto id = ::facade::method_id(#_NAME);                                 \
+        ::facade::function_call_context ctx{id, #_NAME, false, std::move(method),        \
             std::move(overrider), std::move(filter_and_record)};                         \
+        if constexpr (FACADE_HAS_STATIC(t_this_type, recording_policy_##_NAME)) {        \
+            /* the name is only looked up when the policy is declared */                 \
+            const auto declared = [](const auto* self) {                                 \
+                using t_self = std::decay_t<decltype(*self)>;                            \
+                return &t_self::recording_policy_##_NAME();                              \
+            };                                                                           \
+            ctx.declared_policy = declared(static_cast<t_this_type*>(nullptr));          \
+        }                                                                                \
         return call_method<t_ret>(ctx, std::forward<t_args>(args)...);                   \
     }
 
@@ -72,8 +106,14 @@ public:
     static auto _NAME(t_args&&... args)                                                  \
     {                                                                                    \
         using t_ret = decltype(t_impl_type::_NAME(args...));                             \
+        using t_result = typename std::decay<t_ret>::type;                               \
+        if (is_passing_through()) {                                                      \
+            /* fast path, no type erasure and no allocations */                          \
+            return t_result(t_impl_type::_NAME(args...));                                \
+        }                                                                                \
         using t_method = t_ret(t_args...);                                               \
-        using t_filter_and_record = void(std::string&, t_args...);                       \
+        using t_filter_and_record =                                                      \
+            void(std::string&, ::facade::t_call_key*, t_args...);                        \
         std::function method{                                                            \
             [](t_args&&... args) -> t_ret { return t_impl_type::_NAME(args...); }};      \
         std::function<t_method> overrider;                                               \
@@ -90,18 +130,38 @@ public:
                 auto filter_binder = [](auto&... args) -> t_ret {                        \
                     return filter_##_NAME(args...);                                      \
                 };                                                                       \
-                filter_and_record = [filter_binder](                                     \
-                                        std::string& recording, auto&&... args) {        \
-                    ::facade::filter_args_and_record(filter_binder, recording, args...); \
+                filter_and_record = [filter_binder](std::string& recording,              \
+                                        ::facade::t_call_key* key, auto&&... args) {     \
+                    ::facade::filter_args_and_record<t_archive_policy>(                  \
+                        filter_binder, recording, key, args...);                         \
                 };                                                                       \
             }                                                                            \
         }                                                                                \
-        ::facade::function_call_context ctx{#_NAME, true, std::move(method),             \
+        constexpr auto id = ::facade::method_id(#_NAME);                                 \
+        ::facade::function_call_context ctx{id, #_NAME, true, std::move(method),         \
             std::move(overrider), std::move(filter_and_record)};                         \
+        if constexpr (FACADE_HAS_STATIC(t_this_type, recording_policy_##_NAME)) {        \
+            /* the name is only looked up when the policy is declared */                 \
+            const auto declared = [](const auto* self) {                                 \
+                using t_self = std::decay_t<decltype(*self)>;                            \
+                return &t_self::recording_policy_##_NAME();                              \
+            };                                                                           \
+            ctx.declared_policy = declared(static_cast<t_this_type*>(nullptr));          \
+        }                                                                                \
         return get_facade_instance().call_method<t_ret>(                                 \
             ctx, std::forward<t_args>(args)...);                                         \
     }
 
+// Declares how the calls of a method are recorded, i.e.
+//   FACADE_RECORDING_POLICY(read, ::facade::recording_policy::every(100).keep_last(10));
+// A policy set with master::set_recording_policy overrides it
+#define FACADE_RECORDING_POLICY(_NAME, _POLICY)                         \
+    static const ::facade::recording_policy& recording_policy_##_NAME() \
+    {                                                                   \
+        static const ::facade::recording_policy policy = _POLICY;       \
+        return policy;                                                  \
+    }
+
 // TODO : improve this, callback invokers should (probably) be added on construction
 #define FACADE_CALLBACK(_NAME, _RET, ...)                                                \
     FACADE_CHECK_OPTIONAL_METHODS(_NAME)                                                 \
@@ -114,17 +174,22 @@ private:
 public:                                                                                  \
     void register_callback_##_NAME(const t_cbk_func_##_NAME& cbk)                        \
     {                                                                                    \
-        t_lock_guard lg(m_mtx);                                                          \
-        m_callback_invokers[#_NAME] = [this](const ::facade::function_call& call) {      \
-            invoke_##_NAME(call);                                                        \
-        };                                                                               \
-        m_cbk_func_##_NAME = cbk;                                                        \
+        {                                                                                \
+            t_lock_guard lg(m_mtx);                                                      \
+            constexpr auto id = ::facade::method_id(#_NAME);                             \
+            m_callback_invokers[id] = [this](const ::facade::function_call& call) {      \
+                invoke_##_NAME(call);                                                    \
+            };                                                                           \
+            m_cbk_func_##_NAME = cbk;                                                    \
+        }                                                                                \
+        ::facade::master().callback_invoker_registered(this);                            \
     }                                                                                    \
     /* this function has to be a template function to allow if constexpr*/               \
     template <typename t_type = void>                                                    \
     std::function<_RET(__VA_ARGS__)> get_callback_##_NAME()                              \
     {                                                                                    \
-        using t_filter_and_record = void(std::string&, ##__VA_ARGS__);                   \
+        using t_filter_and_record =                                                      \
+            void(std::string&, ::facade::t_call_key*, ##__VA_ARGS__);                    \
         auto method = [this](auto&&... args) -> _RET {                                   \
             return m_cbk_func_##_NAME(args...);                                          \
         };                                                                               \
@@ -134,14 +199,15 @@ public:
                 auto filter_binder = [this](auto&... args) -> _RET {                     \
                     return filter_##_NAME(args...);                                      \
                 };                                                                       \
-                filter_and_record = [filter_binder](                                     \
-                                        std::string& recording, auto&&... args) {        \
-                    ::facade::filter_args_and_record(filter_binder, recording, args...); \
+                filter_and_record = [filter_binder](std::string& recording,              \
+                                        ::facade::t_call_key* key, auto&&... args) {     \
+                    ::facade::filter_args_and_record<t_archive_policy>(                  \
+                        filter_binder, recording, key, args...);                         \
                 };                                                                       \
             }                                                                            \
         }                                                                                \
-        std::string name = #_NAME;                                                       \
-        ::facade::function_call_context ctx{#_NAME, false, method,                       \
+        constexpr auto id = ::facade::method_id(#_NAME);                                 \
+        ::facade::function_call_context ctx{id, #_NAME, false, method,                   \
             std::function<t_filter_and_record>{}, std::move(filter_and_record)};         \
         return create_callback_wrapper<_RET, decltype(ctx), ##__VA_ARGS__>(ctx);         \
     }                                                                                    \
@@ -160,20 +226,28 @@ public:
                 };                                                                       \
             }                                                                            \
         }                                                                                \
-        std::string name = #_NAME;                                                       \
-        ::facade::function_call_context ctx{std::move(name), false, cbk,                 \
+        constexpr auto id = ::facade::method_id(#_NAME);                                 \
+        ::facade::function_call_context ctx{id, #_NAME, false, cbk,                      \
             std::move(overrider), std::function<t_decayed_function>{}};                  \
-        ::facade::invoke_callback<decltype(ctx), _RET, ##__VA_ARGS__>(ctx, call);        \
+        ::facade::invoke_callback<t_archive_policy, decltype(ctx), _RET, ##__VA_ARGS__>( \
+            ctx, m_snapshot->blobs, call);                                               \
     }
 
+// The facade is registered once it's fully constructed and unregistered before
+// it's destroyed, master's threads may call it as soon as it's registered
 #define FACADE_CONSTRUCTOR(_NAME)                                             \
     using t_this_type = _NAME;                                                \
-    _NAME(std::unique_ptr<t_impl_type> ptr) : facade(#_NAME, true)            \
+    _NAME(std::unique_ptr<t_impl_type> ptr) : facade(#_NAME, false)           \
     {                                                                         \
         m_impl = ptr.release();                                               \
+        internal_register();                                                  \
+    }                                                                         \
+    _NAME() : facade(#_NAME, false) { internal_register(); }                  \
+    ~_NAME()                                                                  \
+    {                                                                         \
+        internal_unregister();                                                \
+        delete m_impl;                                                        \
     }                                                                         \
-    _NAME() : facade(#_NAME, true) {}                                         \
-    ~_NAME() { delete m_impl; }                                               \
     void set_impl(std::unique_ptr<t_impl_type>&& impl_ptr)                    \
     {                                                                         \
         m_impl = impl_ptr.release();                                          \
@@ -191,18 +265,22 @@ private:                                                                      \
     _NAME() : facade(#_NAME, false) {}                                        \
                                                                               \
 public:                                                                       \
-    ~_NAME() { m_impl = nullptr; }                                            \
+    ~_NAME()                                                                  \
+    {                                                                         \
+        internal_unregister();                                                \
+        m_impl = nullptr;                                                     \
+    }                                                                         \
     void set_impl(t_impl_type* impl_ptr) { m_impl = impl_ptr; }               \
     using t_callback_initializer = std::function<void(t_impl_type&, _NAME&)>; \
     void rewire_callbacks(const t_callback_initializer& rewire)               \
     {                                                                         \
         rewire(*m_impl, *this);                                               \
     }                                                                         \
-    static auto& get_facade_instance()                                        \
+    /* constructed on the first call, which is thread safe */                 \
+    static _NAME& get_facade_instance()                                       \
     {                                                                         \
-        static std::unique_ptr<_NAME> m_instance;                             \
-        if (!m_instance) m_instance = std::unique_ptr<_NAME>(new _NAME);      \
-        return *m_instance;                                                   \
+        static _NAME instance;                                                \
+        return instance;                                                      \
     }                                                                         \
     void register_facade() { internal_register(); }                           \
     void unregister_facade() { internal_unregister(); }
@@ -211,6 +289,113 @@ namespace facade
 {
     struct function_call;
     struct function_result;
+
+    // Recorded calls of a method are keyed by a fingerprint of their pre-call
+    // arguments
+    using t_call_key = uint64_t;
+
+    // Calls of a method with other arguments but the same key are kept apart, the
+    // one recorded later is stored under the key that follows the shared one
+    inline t_call_key next_call_key(t_call_key key) { return utils::mix64(key + 1); }
+
+    // A recorded call as it's kept by a facade. Calls loaded from an indexed
+    // recording stay encoded in the mapped file until they are looked up
+    struct recorded_call
+    {
+        function_call call;
+        recording_format::blob_span encoded;
+        std::atomic_bool decoded{true};
+        // results recorded while recording, including the ones a recording policy
+        // didn't keep
+        uint64_t results_seen{0};
+        // index of the oldest result, the results are a ring once a recording policy
+        // replaces the oldest one by a new one and are put in order when saved
+        size_t oldest_result{0};
+        // index of the result cursor of a loaded call in the facades replaying it
+        size_t cursor{std::numeric_limits<size_t>::max()};
+        // a loaded call whose key is shared by other arguments, a replay finding it
+        // compares the arguments
+        bool shared_key{false};
+
+        recorded_call() = default;
+        recorded_call(function_call&& that_call) : call(std::move(that_call)) {}
+        recorded_call(recorded_call&& that) noexcept
+            : call(std::move(that.call)),
+              encoded(that.encoded),
+              decoded(that.decoded.load()),
+              results_seen(that.results_seen),
+              oldest_result(that.oldest_result),
+              cursor(that.cursor),
+              shared_key(that.shared_key)
+        {
+        }
+    };
+
+    // A result as it's recorded, its payloads are interned into the blob store of the
+    // facade when the recorded calls are merged
+    struct recorded_result
+    {
+        std::string post_call_args;
+        std::string return_value;
+        t_duration offest_from_origin;
+        t_duration duration;
+    };
+
+    // Recorded calls of one method keyed by the fingerprint of their arguments,
+    // the name is only kept for serialization and logging
+    struct recorded_method
+    {
+        std::string function_name;
+        utils::flat_map<t_call_key, recorded_call> calls;
+    };
+
+    // identifies the archive policy a recording snapshot was loaded with, without RTTI
+    template <typename t_archive_policy>
+    inline constexpr char archive_policy_tag{0};
+
+    // Calls and callbacks of a facade with the blobs they reference. A snapshot
+    // loaded for replay is shared by the facades replaying the same recording and
+    // isn't modified any more, except for encoded calls decoded in place under its
+    // lock. Every facade replaying it keeps its own result cursors
+    struct recording_snapshot
+    {
+        utils::flat_map<t_method_id, recorded_method> calls;
+        std::list<function_call> callbacks;
+        // payloads of the calls and callbacks
+        blob_store blobs;
+        // keeps the mapped recording alive while there are encoded calls or blobs
+        // viewing it
+        std::shared_ptr<const utils::mapped_file> recording;
+        const char* archive_policy{nullptr};
+        // loaded calls, each has a result cursor
+        size_t cursors{0};
+        std::atomic_bool shared{false};
+        std::mutex mtx;
+
+        // called once the calls are loaded
+        void index_calls()
+        {
+            cursors = 0;
+            for (auto& [id, method] : calls) {
+                for (auto& [key, call] : method.calls) {
+                    call.cursor = cursors++;
+                    call.shared_key = method.calls.find(next_call_key(key)) != nullptr;
+                }
+            }
+        }
+    };
+
+    // Calls completed since the previous segment of a streamed recording. A call
+    // can be in several segments, its results are appended in the segment order.
+    // Blob ids of a segment refer to the blobs of that segment
+    struct recording_segment
+    {
+        std::string name;
+        blob_store blobs;
+        std::vector<t_call_key> keys;
+        std::vector<function_call> calls;
+        std::list<function_call> callbacks;
+    };
 }  // namespace facade
 
 namespace cereal
@@ -233,6 +418,9 @@ namespace cereal
         archive(cereal::make_nvp("function_name", call.function_name),
             cereal::make_nvp("pre_call_args", call.pre_call_args),
             cereal::make_nvp("results", call.results));
+        if constexpr (t_archive::is_loading::value) {
+            call.function_id = facade::method_id(call.function_name);
+        }
     }
 
     template <class t_archive>
@@ -243,27 +431,115 @@ namespace cereal
             cereal::make_nvp("offest_from_origin", result.offest_from_origin),
             cereal::make_nvp("duration", result.duration));
     }
+
+    template <class t_archive>
+    void serialize(t_archive& archive, facade::recorded_call& call)
+    {
+        serialize(archive, call.call);
+    }
+
+    template <class t_archive>
+    void serialize(t_archive& archive, facade::recorded_method& method)
+    {
+        archive(cereal::make_nvp("function_name", method.function_name),
+            cereal::make_nvp("calls", method.calls));
+    }
+
+    template <class t_archive>
+    void serialize(t_archive& archive, facade::recording_segment& segment)
+    {
+        archive(cereal::make_nvp("name", segment.name),
+            cereal::make_nvp("blobs", segment.blobs),
+            cereal::make_nvp("keys", segment.keys),
+            cereal::make_nvp("calls", segment.calls),
+            cereal::make_nvp("callbacks", segment.callbacks));
+    }
+
+    template <class t_archive>
+    void save(t_archive& archive, const facade::blob_store& blobs)
+    {
+        archive(cereal::make_size_tag(static_cast<cereal::size_type>(blobs.size())));
+        for (size_t id = 1; id <= blobs.size(); ++id) {
+            archive(std::string{blobs.get(static_cast<facade::t_blob_id>(id))});
+        }
+    }
+
+    template <class t_archive>
+    void load(t_archive& archive, facade::blob_store& blobs)
+    {
+        cereal::size_type size;
+        archive(cereal::make_size_tag(size));
+        blobs.clear();
+        for (cereal::size_type idx = 0; idx < size; ++idx) {
+            std::string blob;
+            archive(blob);
+            blobs.add(std::move(blob));
+        }
+    }
+
+    template <class t_archive, class t_key, class t_value>
+    void save(t_archive& archive, const facade::utils::flat_map<t_key, t_value>& map)
+    {
+        archive(cereal::make_size_tag(static_cast<cereal::size_type>(map.size())));
+        for (const auto& [key, value] : map) archive(cereal::make_map_item(key, value));
+    }
+
+    template <class t_archive, class t_key, class t_value>
+    void load(t_archive& archive, facade::utils::flat_map<t_key, t_value>& map)
+    {
+        cereal::size_type size;
+        archive(cereal::make_size_tag(size));
+        map.clear();
+        map.reserve(static_cast<size_t>(size));
+        for (cereal::size_type idx = 0; idx < size; ++idx) {
+            t_key key;
+            t_value value;
+            archive(cereal::make_map_item(key, value));
+            map.try_emplace(key, std::move(value));
+        }
+    }
 }  // namespace cereal
 
 namespace facade
 {
-    using t_cereal_output_archive = cereal::JSONOutputArchive;
-    using t_cereal_input_archive = cereal::JSONInputArchive;
-    using t_hasher = digestpp::md5;
+    // Archive policies select how a facade's recording and the argument payloads
+    // inside it are serialized. JSON is human readable and meant for debugging,
+    // binary stores payloads as raw length-prefixed bytes and is much faster and
+    // smaller for large recordings. Binary recordings are written in the indexed
+    // format from recording.h and are decoded lazily after being memory mapped
+    struct json_archive_policy
+    {
+        using t_output_archive = cereal::JSONOutputArchive;
+        using t_input_archive = cereal::JSONInputArchive;
+        static constexpr bool indexed_recording = false;
+    };
+
+    struct binary_archive_policy
+    {
+        using t_output_archive = cereal::BinaryOutputArchive;
+        using t_input_archive = cereal::BinaryInputArchive;
+        static constexpr bool indexed_recording = true;
+    };
 
     template <typename t_function, typename t_overrider, typename t_filter_and_record>
     struct function_call_context
     {
-        std::string function_name;
+        t_method_id function_id;
+        const char* function_name;
         bool static_function{false};
         t_function function;
         t_overrider overrider;
         t_filter_and_record filter_and_record;
+        // declared with FACADE_RECORDING_POLICY next to the method
+        const recording_policy* declared_policy{nullptr};
+        // counters of the method, null while master doesn't collect stats
+        method_counters* counters{nullptr};
 
-        function_call_context(std::string _function_name, bool _static_function,
-            t_function _function, t_overrider _overrider,
+        function_call_context(t_method_id _function_id, const char* _function_name,
+            bool _static_function, t_function _function, t_overrider _overrider,
             t_filter_and_record _filter_and_record)
-            : function_name(std::move(_function_name)),
+            : function_id(_function_id),
+              function_name(_function_name),
               static_function(_static_function),
               function(std::move(_function)),
               overrider(std::move(_overrider)),
@@ -275,11 +551,11 @@ namespace facade
     template <typename t_archive>
     class arg_unpacker
     {
-        const std::string& m_function_name;
+        const char* m_function_name;
         t_archive& m_archive;
 
     public:
-        arg_unpacker(const std::string& function_name, t_archive& archive)
+        arg_unpacker(const char* function_name, t_archive& archive)
             : m_function_name(function_name), m_archive(archive)
         {
         }
@@ -309,108 +585,346 @@ namespace facade
         }
     };
 
-    template <typename... t_args>
-    void unpack(
-        const std::string& function_name, const std::string& recorded, t_args&&... args)
+    template <typename t_archive_policy, typename... t_args>
+    void unpack(const char* function_name, std::string_view recorded, t_args&&... args)
     {
         if (recorded.empty()) return;
-        std::stringstream ss;
-        ss.str(recorded);
-        t_cereal_input_archive archive{ss};
+        utils::memory_istream stream{recorded.data(), recorded.size()};
+        typename t_archive_policy::t_input_archive archive{stream};
         arg_unpacker unpacker{function_name, archive};
         utils::visit_args(unpacker, std::forward<t_args>(args)...);
     }
 
-    template <typename t_ret, typename... t_args>
-    void unpack_callback(const function_call& this_call, std::any& any_ret,
-        std::tuple<t_args...>& args_tuple)
+    template <typename t_archive_policy, typename t_ret, typename... t_args>
+    void unpack_callback(const function_call& this_call, const blob_store& blobs,
+        std::any& any_ret, std::tuple<t_args...>& args_tuple)
     {
-        const auto& callback_result = this_call.get_next_result(result_selection::once);
+        // a recorded callback has a single result, the facades sharing the recording
+        // all replay it
+        const auto& callback_result = this_call.results.at(0);
         std::apply(
-            [&this_call](t_args&... args) {
-                unpack(this_call.function_name, this_call.pre_call_args, args...);
+            [&this_call, &blobs](t_args&... args) {
+                unpack<t_archive_policy>(this_call.function_name.c_str(),
+                    blobs.get(this_call.pre_call_args), args...);
             },
             args_tuple);
 
         constexpr const bool has_return = !std::is_same<t_ret, void>::value;
         if constexpr (has_return) {
             t_ret ret;
-            unpack(this_call.function_name, callback_result.return_value, ret);
+            unpack<t_archive_policy>(this_call.function_name.c_str(),
+                blobs.get(callback_result.return_value), ret);
             any_ret = ret;
         }
     }
 
-    template <typename t_ctx, typename t_ret, typename... t_args>
-    void invoke_callback(t_ctx& ctx, const function_call& this_call)
+    template <typename t_archive_policy, typename t_ctx, typename t_ret,
+        typename... t_args>
+    void invoke_callback(
+        t_ctx& ctx, const blob_store& blobs, const function_call& this_call)
     {
         if (!ctx.function) return;
 
         std::any any_ret;
         std::tuple<typename std::decay<t_args>::type...> pre_call_args_tuple;
-        std::tuple<typename std::decay<t_args>::type...> post_call_args_tuple;
 
-        unpack_callback<t_ret>(this_call, any_ret, pre_call_args_tuple);
+        unpack_callback<t_archive_policy, t_ret>(
+            this_call, blobs, any_ret, pre_call_args_tuple);
 
         // override arguments
         if (ctx.overrider) std::apply(ctx.overrider, pre_call_args_tuple);
 
         constexpr const bool has_return = !std::is_same<t_ret, void>::value;
         if constexpr (has_return) {
-            t_ret ret = std::apply(ctx.function, pre_call_args_tuple);
+            [[maybe_unused]] t_ret ret = std::apply(ctx.function, pre_call_args_tuple);
             // TODO: [CALLBACKS] check callback post call and return values
         } else {
             std::apply(ctx.function, pre_call_args_tuple);
         }
     }
 
-    template <typename... t_args>
+    template <typename t_archive_policy, typename... t_args>
     void record_args(std::string& recorded, t_args&&... args)
     {
         std::stringstream ss;
         {
-            t_cereal_output_archive archive{ss};
+            typename t_archive_policy::t_output_archive archive{ss};
             utils::visit_args(archive, std::forward<t_args>(args)...);
         }
         recorded = ss.str();
     }
 
-    template <typename t_filter_func, typename... t_args>
+    namespace utils
+    {
+        template <typename t_value, typename = void>
+        struct is_tuple_like : std::false_type
+        {
+        };
+
+        template <typename t_value>
+        struct is_tuple_like<t_value,
+            std::void_t<decltype(std::tuple_size<t_value>::value)>> : std::true_type
+        {
+        };
+
+        template <typename t_value, typename = void>
+        struct is_range : std::false_type
+        {
+        };
+
+        template <typename t_value>
+        struct is_range<t_value,
+            std::void_t<decltype(std::begin(std::declval<const t_value&>())),
+                decltype(std::end(std::declval<const t_value&>()))>> : std::true_type
+        {
+        };
+
+        template <typename t_value>
+        struct is_optional : std::false_type
+        {
+        };
+
+        template <typename t_value>
+        struct is_optional<std::optional<t_value>> : std::true_type
+        {
+        };
+
+        template <typename t_value>
+        struct is_smart_pointer : std::false_type
+        {
+        };
+
+        template <typename t_value, typename t_deleter>
+        struct is_smart_pointer<std::unique_ptr<t_value, t_deleter>> : std::true_type
+        {
+        };
+
+        template <typename t_value>
+        struct is_smart_pointer<std::shared_ptr<t_value>> : std::true_type
+        {
+        };
+
+        template <typename t_value>
+        struct is_duration : std::false_type
+        {
+        };
+
+        template <typename t_rep, typename t_period>
+        struct is_duration<std::chrono::duration<t_rep, t_period>> : std::true_type
+        {
+        };
+
+        // decoded return value and out-parameters of a recorded call, const
+        // parameters have a slot too but it's never copied out
+        template <typename t_ret, typename... t_args>
+        struct decoded_values
+        {
+            using t_ret_value = typename std::conditional<std::is_void<t_ret>::value,
+                std::tuple<>, typename std::decay<t_ret>::type>::type;
+
+            std::tuple<typename std::decay<t_args>::type...> post_call_args;
+            // arguments are left as they are when nothing was recorded for them
+            bool has_post_call_args{false};
+            t_ret_value ret{};
+        };
+
+        // results of move-only types can't be replayed from a shared copy
+        template <typename t_ret, typename... t_args>
+        struct is_cacheable_result
+            : std::conjunction<std::is_copy_constructible<
+                                   typename decoded_values<t_ret>::t_ret_value>,
+                  std::is_copy_assignable<typename std::decay<t_args>::type>...>
+        {
+        };
+
+        template <typename t_arg, typename t_value>
+        void assign_out_arg(t_arg& arg, const t_value& value)
+        {
+            if constexpr (!std::is_const<t_arg>::value) arg = value;
+        }
+    }  // namespace utils
+
+    // Feeds argument values into a hash_builder without serializing them. Values
+    // are hashed by what they hold rather than by their exact type, so an int and
+    // a long or a string literal and a std::string holding the same value get the
+    // same key. Types it doesn't know are hashed through their binary cereal
+    // serialization
+    class arg_hasher
+    {
+        utils::hash_builder& m_builder;
+
+    public:
+        explicit arg_hasher(utils::hash_builder& builder) : m_builder(builder) {}
+
+        template <typename t_arg>
+        void operator()(const t_arg& arg)
+        {
+            using t_value = typename std::decay<t_arg>::type;
+            if constexpr (std::is_integral<t_value>::value) {
+                if constexpr (std::is_signed<t_value>::value) {
+                    m_builder.add(static_cast<uint64_t>(static_cast<int64_t>(arg)));
+                } else {
+                    m_builder.add(static_cast<uint64_t>(arg));
+                }
+            } else if constexpr (std::is_enum<t_value>::value) {
+                (*this)(static_cast<typename std::underlying_type<t_value>::type>(arg));
+            } else if constexpr (std::is_floating_point<t_value>::value) {
+                const double value = static_cast<double>(arg);
+                uint64_t bits;
+                std::memcpy(&bits, &value, sizeof(bits));
+                m_builder.add(bits);
+            } else if constexpr (std::is_convertible<const t_arg&,
+                                     std::string_view>::value) {
+                // arrays decay to pointers but can't be null
+                if constexpr (std::is_pointer<std::remove_reference_t<t_arg>>::value) {
+                    if (!arg) {
+                        m_builder.add(0);
+                        return;
+                    }
+                }
+                const std::string_view view{arg};
+                m_builder.add_bytes(view.data(), view.size());
+            } else if constexpr (utils::is_duration<t_value>::value) {
+                (*this)(arg.count());
+            } else if constexpr (utils::is_optional<t_value>::value ||
+                utils::is_smart_pointer<t_value>::value) {
+                m_builder.add(static_cast<bool>(arg));
+                if (arg) (*this)(*arg);
+            } else if constexpr (utils::is_tuple_like<t_value>::value) {
+                const auto hash_values = [this](const auto&... values) {
+                    ((*this)(values), ...);
+                };
+                std::apply(hash_values, arg);
+            } else if constexpr (utils::is_range<t_value>::value) {
+                uint64_t size = 0;
+                for (const auto& value : arg) {
+                    (*this)(value);
+                    ++size;
+                }
+                m_builder.add(size);
+            } else {
+                std::ostringstream ss;
+                {
+                    cereal::BinaryOutputArchive archive{ss};
+                    archive(arg);
+                }
+                const auto bytes = ss.str();
+                m_builder.add_bytes(bytes.data(), bytes.size());
+            }
+        }
+    };
+
+    // Key of a call with the given pre-call arguments, calls without arguments all
+    // have the same key and skip hashing
+    template <typename... t_args>
+    t_call_key calculate_key(const t_args&... args)
+    {
+        if constexpr (sizeof...(t_args) == 0) {
+            return 0;
+        } else {
+            utils::hash_builder builder;
+            arg_hasher hasher{builder};
+            (hasher(args), ...);
+            return builder.finish();
+        }
+    }
+
+    // the key is calculated from the filtered arguments if it's requested
+    template <typename t_archive_policy, typename t_filter_func, typename... t_args>
     void filter_args_and_record(
-        t_filter_func& filter, std::string& recorded, t_args&&... args)
+        t_filter_func& filter, std::string& recorded, t_call_key* key, t_args&&... args)
     {
         // make a copy of arguments so we don't modify the source
         auto args_tuple = std::make_tuple(args...);
         // filter the copies
         std::apply(filter, args_tuple);
         // bind the outpur string with the filtered args
-        auto call_record_args = [&recorded](
+        auto call_record_args = [&recorded, key](
                                     typename std::decay<t_args>::type&... lambda_args) {
-            record_args(recorded, std::forward<t_args>(lambda_args)...);
+            if (key) *key = calculate_key(lambda_args...);
+            record_args<t_archive_policy>(recorded, std::forward<t_args>(lambda_args)...);
         };
 
         std::apply(call_record_args, args_tuple);
     }
 
-    inline std::string calculate_hash(const std::string& data)
-    {
-        return t_hasher{}.absorb(data).hexdigest();
-    }
-
     class facade_base : public facade_interface
     {
     protected:
         // clang-format off
-        std::unordered_map<
-            std::string,
-            std::unordered_map<
-                std::string,
-                function_call>> m_calls;
+        // recorded or loaded calls, a loaded snapshot may be shared with the other
+        // facades replaying the same recording
+        std::shared_ptr<recording_snapshot> m_snapshot{
+            std::make_shared<recording_snapshot>()};
+        // positions of the replays of this facade in the calls of m_snapshot, they
+        // are allocated by the first replay
+        std::atomic<replay_cursors*> m_cursors{nullptr};
+
+        utils::flat_map<
+            t_method_id,
+            std::function<void(const function_call&)>> m_callback_invokers;
 
-        std::list<function_call> m_callbacks;
+        // results evicted by recording policies since the blobs were compacted, the
+        // blobs they referenced stay in the snapshot until then
+        size_t m_evicted_results{0};
 
-        std::unordered_map<
-            std::string,
-            std::function<void(const function_call&)>> m_callback_invokers;
+        // A call recorded by a thread is appended to a buffer owned by that thread
+        // and is moved into m_snapshot when the recording is saved, so threads
+        // recording through the same facade don't contend on m_mtx. The buffer
+        // mutex is only contended while the buffers are being merged
+        struct pending_call
+        {
+            bool callback{false};
+            t_method_id function_id{0};
+            const char* function_name{nullptr};
+            t_call_key key{0};
+            std::string pre_call_args;
+            recorded_result result;
+            // bytes accounted to master's memory budget of a streamed recording
+            size_t reserved{0};
+        };
+
+        struct recording_buffer
+        {
+            std::mutex mtx;
+            std::vector<pending_call> calls;
+            // set once the facade is destroyed, the owning thread drops the buffer
+            std::atomic_bool orphaned{false};
+            // set once the owning thread exits, the buffer is dropped once its calls
+            // are taken or another thread takes it over
+            std::atomic_bool released{false};
+        };
+
+        // buffers of the facades a thread recorded through, released when it exits
+        struct thread_buffers
+        {
+            std::vector<std::pair<uint64_t, std::shared_ptr<recording_buffer>>> entries;
+
+            ~thread_buffers()
+            {
+                for (auto& [_unused, buffer] : entries) buffer->released = true;
+            }
+        };
+
+        std::vector<std::shared_ptr<recording_buffer>> m_buffers;
+        std::mutex m_buffers_mtx;
+        const uint64_t m_uid{next_uid()};
+        // bytes of the calls merged into m_snapshot since the last flush that are
+        // accounted to master's memory budget
+        size_t m_unflushed_bytes{0};
+        // calls recorded since the facade was cleared
+        std::atomic<uint64_t> m_new_calls{0};
+
+        // recording policies of methods by their id, read by every recorded call once
+        // any method has one. A null sampler falls back to the declared policy
+        utils::flat_map<t_method_id, std::shared_ptr<method_sampler>> m_samplers;
+        std::shared_mutex m_samplers_mtx;
+        std::atomic_bool m_has_samplers{false};
+
+        // master's counters of the methods of this facade by their id, looked up by
+        // the first call of a method made while stats are collected
+        utils::flat_map<t_method_id, method_counters*> m_counters;
+        std::shared_mutex m_counters_mtx;
 
         std::mutex m_mtx;
         const std::string m_name;
@@ -419,55 +933,421 @@ namespace facade
         // clang-format on
 
         using t_lock_guard = std::lock_guard<decltype(m_mtx)>;
-        using t_method_record_inserter = void(const std::string& method_name,
-            std::string& pre_call_args, function_result&& result);
 
-        bool is_playing() const { return master().is_playing(); }
-        bool is_recording() const { return master().is_recording(); }
-        bool is_passing_through() const { return master().is_passing_through(); }
+        // pending calls of a thread merged at once while recording policies apply
+        static constexpr size_t policy_merge_batch = 4096;
+
+        // facades are told apart by an id rather than by address in the per-thread
+        // buffer lists because a new facade may reuse the address of a deleted one
+        static uint64_t next_uid()
+        {
+            static std::atomic<uint64_t> uid{0};
+            return ++uid;
+        }
+
+        recording_buffer& this_thread_buffer()
+        {
+            thread_local thread_buffers buffers;
+            for (const auto& [uid, buffer] : buffers.entries) {
+                if (uid == m_uid) return *buffer;
+            }
+
+            auto& entries = buffers.entries;
+            const auto is_orphaned = [](const auto& entry) {
+                return entry.second->orphaned.load();
+            };
+            entries.erase(std::remove_if(entries.begin(), entries.end(), is_orphaned),
+                entries.end());
+            std::shared_ptr<recording_buffer> buffer;
+            {
+                std::lock_guard<std::mutex> lg(m_buffers_mtx);
+                // the buffer of a thread that exited is taken over with the calls it
+                // still holds, a facade used by short lived threads doesn't keep a
+                // buffer for each of them
+                for (const auto& candidate : m_buffers) {
+                    if (candidate->released.load()) {
+                        buffer = candidate;
+                        buffer->released = false;
+                        break;
+                    }
+                }
+                if (!buffer) {
+                    buffer = std::make_shared<recording_buffer>();
+                    m_buffers.push_back(buffer);
+                }
+            }
+            entries.emplace_back(m_uid, buffer);
+            return *buffer;
+        }
+
+        static size_t recorded_size(const pending_call& call)
+        {
+            return sizeof(call) + call.pre_call_args.size() +
+                call.result.post_call_args.size() + call.result.return_value.size();
+        }
+
+        void append_pending_call(pending_call&& call, method_counters* counters)
+        {
+            m_new_calls.fetch_add(1, std::memory_order_relaxed);
+            add_to_counter(counters, &method_counters::recorded);
+            add_to_counter(counters, &method_counters::bytes_serialized,
+                call.pre_call_args.size() + call.result.post_call_args.size() +
+                    call.result.return_value.size());
+            // accounted before the call can be flushed, so the count never goes
+            // below what is still held
+            if (master().is_streaming()) {
+                const stage_timer waiting{counters, &method_counters::lock_wait_ns};
+                call.reserved = recorded_size(call);
+                master().reserve_recording_memory(call.reserved);
+            }
+            auto& buffer = this_thread_buffer();
+            bool merge = false;
+            {
+                std::unique_lock<std::mutex> lk(buffer.mtx, std::defer_lock);
+                {
+                    const stage_timer waiting{counters, &method_counters::lock_wait_ns};
+                    lk.lock();
+                }
+                buffer.calls.emplace_back(std::move(call));
+                merge = buffer.calls.size() >= policy_merge_batch &&
+                    m_has_samplers.load(std::memory_order_relaxed) &&
+                    master().is_recording();
+            }
+            // results dropped by the recording policies only stop taking memory
+            // once they are merged. In hybrid mode the recorded calls are being
+            // replayed without a lock, so nothing is merged until it's stopped
+            if (merge) {
+                std::unique_lock<std::mutex> lk(m_mtx, std::defer_lock);
+                {
+                    const stage_timer waiting{counters, &method_counters::lock_wait_ns};
+                    lk.lock();
+                }
+                unprotected_merge_pending_calls();
+            }
+        }
+
+        std::vector<pending_call> take_pending_calls()
+        {
+            std::vector<pending_call> pending;
+            std::lock_guard<std::mutex> lg(m_buffers_mtx);
+            const auto take = [&pending](recording_buffer& buffer) {
+                // no calls are added to a buffer after its thread released it
+                const bool released = buffer.released.load();
+                std::lock_guard<std::mutex> buffer_lg(buffer.mtx);
+                std::move(buffer.calls.begin(), buffer.calls.end(),
+                    std::back_inserter(pending));
+                buffer.calls.clear();
+                return released;
+            };
+            // the buffers of the threads that exited are dropped once they are empty
+            size_t kept = 0;
+            for (size_t idx = 0; idx < m_buffers.size(); ++idx) {
+                if (take(*m_buffers[idx])) continue;
+                if (kept != idx) m_buffers[kept] = std::move(m_buffers[idx]);
+                ++kept;
+            }
+            m_buffers.resize(kept);
+            return pending;
+        }
+
+        // decodes a call loaded from an indexed recording, if it's still encoded
+        virtual void decode_recorded_call(recorded_call& call) = 0;
+
+        // The call of a method made with the given pre-call arguments, inserted if
+        // it's new. A call with other arguments that has the same key is skipped
+        // and the following key is tried
+        recorded_call& unprotected_emplace_call(recorded_method& method,
+            t_call_key key, std::string_view pre_call_args, bool& inserted)
+        {
+            while (true) {
+                auto* call = method.calls.find(key);
+                if (!call) {
+                    inserted = true;
+                    return method.calls[key];
+                }
+                decode_recorded_call(*call);
+                if (m_snapshot->blobs.get(call->call.pre_call_args) == pre_call_args) {
+                    inserted = false;
+                    return *call;
+                }
+                key = next_call_key(key);
+            }
+        }
+
+        function_result intern_result(recorded_result&& recorded)
+        {
+            auto& blobs = m_snapshot->blobs;
+            function_result result;
+            result.post_call_args = blobs.intern(std::move(recorded.post_call_args));
+            result.return_value = blobs.intern(std::move(recorded.return_value));
+            result.offest_from_origin = recorded.offest_from_origin;
+            result.duration = recorded.duration;
+            return result;
+        }
+
+        // calls are merged in the order they were made, so results of the same call
+        // recorded by different threads keep their order in the recording
+        void unprotected_merge_pending_calls()
+        {
+            unprotected_own_snapshot();
+            const bool has_samplers = m_has_samplers.load(std::memory_order_acquire);
+            std::shared_lock<std::shared_mutex> samplers_lk(
+                m_samplers_mtx, std::defer_lock);
+            if (has_samplers) samplers_lk.lock();
+            auto pending = take_pending_calls();
+            std::stable_sort(pending.begin(), pending.end(),
+                [](const pending_call& lhv, const pending_call& rhv) {
+                    return lhv.result.offest_from_origin < rhv.result.offest_from_origin;
+                });
+
+            for (auto& pending_call : pending) {
+                m_unflushed_bytes += pending_call.reserved;
+                if (pending_call.callback) {
+                    function_call callback_call;
+                    callback_call.function_id = pending_call.function_id;
+                    callback_call.function_name = pending_call.function_name;
+                    callback_call.pre_call_args =
+                        m_snapshot->blobs.intern(std::move(pending_call.pre_call_args));
+                    callback_call.results.emplace_back(
+                        intern_result(std::move(pending_call.result)));
+                    m_snapshot->callbacks.emplace_back(std::move(callback_call));
+                    continue;
+                }
+
+                auto&& [method, new_method] =
+                    m_snapshot->calls.try_emplace(pending_call.function_id);
+                if (new_method) method->function_name = pending_call.function_name;
+                bool inserted = false;
+                auto& method_call = unprotected_emplace_call(
+                    *method, pending_call.key, pending_call.pre_call_args, inserted);
+                auto& call = method_call.call;
+                if (inserted) {
+                    call.function_id = pending_call.function_id;
+                    call.function_name = pending_call.function_name;
+                    call.pre_call_args =
+                        m_snapshot->blobs.intern(std::move(pending_call.pre_call_args));
+                }
+                const uint64_t seen = method_call.results_seen++;
+                if (has_samplers) {
+                    auto* sampler = unprotected_find_sampler(pending_call.function_id);
+                    const auto decision = sampler
+                        ? sampler->retain(call.results.size(), seen)
+                        : method_sampler::retention_decision{};
+                    if (!decision.keep) continue;
+                    if (decision.evict) {
+                        ++m_evicted_results;
+                        auto& results = call.results;
+                        // replacing the oldest result, the hot path of keep_last,
+                        // doesn't move the others
+                        if (*decision.evict == 0) {
+                            auto& oldest = method_call.oldest_result;
+                            results[oldest] =
+                                intern_result(std::move(pending_call.result));
+                            oldest = (oldest + 1) % results.size();
+                            continue;
+                        }
+                        restore_result_order(method_call);
+                        results.erase(results.begin() + *decision.evict);
+                    }
+                }
+                restore_result_order(method_call);
+                call.results.emplace_back(intern_result(std::move(pending_call.result)));
+            }
+
+            // compacting costs about as much as the blobs it could release
+            const size_t compaction_threshold =
+                std::max<size_t>(m_snapshot->blobs.size(), 1024);
+            if (!m_snapshot->recording && m_evicted_results > compaction_threshold) {
+                unprotected_compact_blobs();
+            }
+        }
+
+        static void restore_result_order(recorded_call& recorded)
+        {
+            if (recorded.oldest_result == 0) return;
+            auto& results = recorded.call.results;
+            std::rotate(results.begin(), results.begin() + recorded.oldest_result,
+                results.end());
+            recorded.oldest_result = 0;
+        }
+
+        void unprotected_restore_result_order()
+        {
+            for (auto& [id, method] : m_snapshot->calls) {
+                for (auto& [key, call] : method.calls) restore_result_order(call);
+            }
+        }
+
+        // the blobs no call references any more are released, the ids of the others
+        // change. Only done while recording, calls loaded from a recording may
+        // still be encoded and reference blobs by their ids
+        void unprotected_compact_blobs()
+        {
+            blob_store blobs;
+            const auto& compacted = m_snapshot->blobs;
+            std::vector<t_blob_id> ids(compacted.size() + 1, 0);
+            const auto remap = [&compacted, &blobs, &ids](t_blob_id& id) {
+                if (id == 0) return;
+                if (ids[id] == 0) ids[id] = blobs.intern(std::string{compacted.get(id)});
+                id = ids[id];
+            };
+            const auto remap_call = [&remap](function_call& call) {
+                remap(call.pre_call_args);
+                for (auto& result : call.results) {
+                    remap(result.post_call_args);
+                    remap(result.return_value);
+                }
+            };
+            for (auto& [id, method] : m_snapshot->calls) {
+                for (auto& [key, call] : method.calls) remap_call(call.call);
+            }
+            for (auto& callback : m_snapshot->callbacks) remap_call(callback);
+            m_snapshot->blobs = std::move(blobs);
+            m_evicted_results = 0;
+        }
+
+        // the lock of the samplers has to be held
+        method_sampler* unprotected_find_sampler(t_method_id function_id)
+        {
+            const auto* sampler = m_samplers.find(function_id);
+            return sampler ? sampler->get() : nullptr;
+        }
+
+        // decides whether a call made while recording is recorded, a method without
+        // a policy costs a single atomic load
+        template <typename t_ctx>
+        bool should_record(const t_ctx& ctx)
+        {
+            if (!ctx.declared_policy && !m_has_samplers.load(std::memory_order_acquire)) {
+                return true;
+            }
+            {
+                std::shared_lock<std::shared_mutex> lk(m_samplers_mtx);
+                if (auto* sampler = unprotected_find_sampler(ctx.function_id)) {
+                    return sampler->should_record();
+                }
+            }
+            if (!ctx.declared_policy) return true;
+
+            auto declared = std::make_shared<method_sampler>(*ctx.declared_policy);
+            std::unique_lock<std::shared_mutex> lk(m_samplers_mtx);
+            auto& sampler = m_samplers[ctx.function_id];
+            // another thread may have got here first or a policy may have been set
+            if (!sampler) sampler = std::move(declared);
+            m_has_samplers = true;
+            return sampler->should_record();
+        }
+
+        void facade_set_recording_policy(
+            t_method_id function_id, const recording_policy* policy) override
+        {
+            auto sampler = policy ? std::make_shared<method_sampler>(*policy) : nullptr;
+            std::unique_lock<std::shared_mutex> lk(m_samplers_mtx);
+            m_samplers[function_id] = std::move(sampler);
+            m_has_samplers = true;
+        }
+
+        // the counters of a method of this facade, other facades of the same class
+        // may have other names
+        method_counters& method_counters_of(
+            t_method_id function_id, const char* function_name)
+        {
+            {
+                std::shared_lock<std::shared_mutex> lk(m_counters_mtx);
+                if (const auto* counters = m_counters.find(function_id)) {
+                    return **counters;
+                }
+            }
+            auto& counters = master().get_method_counters(m_name, function_name);
+            std::unique_lock<std::shared_mutex> lk(m_counters_mtx);
+            m_counters[function_id] = &counters;
+            return counters;
+        }
+
+        static bool is_playing() { return master().is_playing(); }
+        static bool is_recording() { return master().is_recording(); }
+        static bool is_passing_through() { return master().is_passing_through(); }
 
         static bool is_overriding_arguments()
         {
             return master().is_overriding_arguments();
         }
 
-        void facade_load(std::istream& stream) override
+        void release_cursors() { delete m_cursors.exchange(nullptr); }
+
+        void unprotected_reset_snapshot()
         {
-            t_lock_guard lg(m_mtx);
-            t_cereal_input_archive archive{stream};
+            m_snapshot = std::make_shared<recording_snapshot>();
+            release_cursors();
+        }
 
-            std::string name;
-            archive(cereal::make_nvp("name", name));
-            if (name != m_name) {
-                throw std::runtime_error{
-                    std::string{"name in the recording is not matching: "} + name + " " +
-                    m_name};
+        // a snapshot shared with other facades isn't modified, a facade recording
+        // after it replayed one starts from a snapshot of its own
+        void unprotected_own_snapshot()
+        {
+            if (m_snapshot->shared.load()) unprotected_reset_snapshot();
+        }
+
+        // the position of this facade in the results of a call it replays
+        result_cursor& replay_cursor(const recorded_call& call)
+        {
+            const size_t cursors_num = m_snapshot->cursors;
+            if (call.cursor >= cursors_num) return call.call.current_result;
+            auto* cursors = m_cursors.load(std::memory_order_acquire);
+            if (!cursors) {
+                auto allocated = std::make_unique<replay_cursors>(cursors_num);
+                if (m_cursors.compare_exchange_strong(
+                        cursors, allocated.get(), std::memory_order_acq_rel)) {
+                    cursors = allocated.release();
+                }
             }
+            return (*cursors)[call.cursor];
+        }
 
-            archive(cereal::make_nvp("calls", m_calls),
-                cereal::make_nvp("callbacks", m_callbacks));
+        std::shared_ptr<recording_snapshot> facade_share_snapshot() override
+        {
+            t_lock_guard lg(m_mtx);
+            m_snapshot->shared = true;
+            return m_snapshot;
         }
 
         void facade_clear() override
         {
             t_lock_guard lg(m_mtx);
-            m_calls.clear();
-            m_callbacks.clear();
+            // the dropped calls don't take memory of a streamed recording any more
+            size_t released = std::exchange(m_unflushed_bytes, 0);
+            for (const auto& call : take_pending_calls()) released += call.reserved;
+            if (released != 0) master().release_recording_memory(released);
+            unprotected_reset_snapshot();
+            m_evicted_results = 0;
+            m_new_calls = 0;
         }
 
+        bool facade_has_new_calls() const override { return m_new_calls.load() != 0; }
+
         const std::list<function_call>& get_callbacks() const override
         {
-            return m_callbacks;
+            return m_snapshot->callbacks;
         }
 
         void invoke_callback(const function_call& callback) override
         {
-            const auto it = m_callback_invokers.find(callback.function_name);
-            // callback invoker for this callback is not found
-            // TODO: should probably warn the client about that
-            if (it == m_callback_invokers.end()) return;
+            std::function<void(const function_call&)> invoker;
+            {
+                t_lock_guard lg(m_mtx);
+                const auto* found = m_callback_invokers.find(callback.function_id);
+                // callback invoker for this callback is not found
+                // TODO: should probably warn the client about that
+                if (!found) return;
+                invoker = *found;
+            }
+            invoker(callback);
+        }
 
-            m_callback_invokers[callback.function_name](callback);
+        bool has_callback_invoker(t_method_id function_id) override
+        {
+            t_lock_guard lg(m_mtx);
+            return m_callback_invokers.find(function_id) != nullptr;
         }
 
         void internal_register()
@@ -484,147 +1364,544 @@ namespace facade
             m_is_registered = false;
         }
 
-        facade_base(std::string name, bool register_on_construction)
-            : m_name(std::move(name))
-        {
-            if (register_on_construction) internal_register();
-        }
+        facade_base(std::string name) : m_name(std::move(name)) {}
 
     public:
         const std::string& facade_name() const override { return m_name; }
 
-        void facade_save(std::ostream& stream) override
+        ~facade_base()
         {
-            t_lock_guard lg(m_mtx);
-            t_cereal_output_archive archive{stream};
-            archive(cereal::make_nvp("name", m_name), cereal::make_nvp("calls", m_calls),
-                cereal::make_nvp("callbacks", m_callbacks));
+            internal_unregister();
+            release_cursors();
+            std::lock_guard<std::mutex> lg(m_buffers_mtx);
+            for (auto& buffer : m_buffers) buffer->orphaned = true;
         }
-
-        ~facade_base() { internal_unregister(); }
     };
 
-    template <typename t_type>
+    template <typename t_type, typename t_policy = json_archive_policy>
     class facade : public facade_base
     {
+    public:
+        using t_archive_policy = t_policy;
+
     protected:
+        using t_output_archive = typename t_archive_policy::t_output_archive;
+        using t_input_archive = typename t_archive_policy::t_input_archive;
+
         t_type* m_impl{nullptr};
 
+        void check_recording_name(const std::string& name) const
+        {
+            if (name != m_name) {
+                throw std::runtime_error{
+                    std::string{"name in the recording is not matching: "} + name + " " +
+                    m_name};
+            }
+        }
+
+        void unprotected_load_indexed(std::shared_ptr<const utils::mapped_file> recording)
+        {
+            const auto recording_index =
+                recording_format::read_index<t_archive_policy>(*recording);
+            check_recording_name(recording_index.name);
+
+            // blobs are views into the mapped file
+            for (const auto& span : recording_index.blobs) {
+                recording_format::check_span(*recording, span);
+                m_snapshot->blobs.add_view({recording->data() + span.offset,
+                    static_cast<size_t>(span.size)});
+            }
+
+            // only the index is read here, calls are decoded on the first lookup
+            for (const auto& entry : recording_index.calls) {
+                auto& method = m_snapshot->calls[method_id(entry.function_name)];
+                method.function_name = entry.function_name;
+                auto& call = method.calls[entry.key];
+                call.encoded = entry.span;
+                call.decoded = false;
+            }
+
+            recording_format::read_blob<t_archive_policy>(
+                *recording, recording_index.callbacks, m_snapshot->callbacks);
+            m_snapshot->recording = std::move(recording);
+        }
+
+        // blob ids of a segment are replaced by the ids of the same blobs in the
+        // snapshot
+        void unprotected_intern_segment_blobs(recording_segment& segment)
+        {
+            std::vector<t_blob_id> ids(segment.blobs.size() + 1, 0);
+            for (size_t id = 1; id < ids.size(); ++id) {
+                const auto blob = segment.blobs.get(static_cast<t_blob_id>(id));
+                ids[id] = m_snapshot->blobs.intern(std::string{blob});
+            }
+            const auto remap = [&ids](t_blob_id& id) {
+                if (id >= ids.size()) {
+                    throw std::runtime_error{"a recording references an unknown blob"};
+                }
+                id = ids[id];
+            };
+            const auto remap_call = [&remap](function_call& call) {
+                remap(call.pre_call_args);
+                for (auto& result : call.results) {
+                    remap(result.post_call_args);
+                    remap(result.return_value);
+                }
+            };
+            for (auto& call : segment.calls) remap_call(call);
+            for (auto& callback : segment.callbacks) remap_call(callback);
+        }
+
+        void unprotected_load_streamed(const utils::mapped_file& recording)
+        {
+            bool truncated = false;
+            const auto segments = recording_format::find_segments(recording, truncated);
+            auto& calls = m_snapshot->calls;
+            auto& callbacks = m_snapshot->callbacks;
+            for (const auto& span : segments) {
+                recording_segment segment;
+                recording_format::read_blob<t_archive_policy>(recording, span, segment);
+                check_recording_name(segment.name);
+                if (segment.keys.size() != segment.calls.size()) {
+                    throw std::runtime_error{
+                        "a recording segment is corrupted in " + m_name};
+                }
+                unprotected_intern_segment_blobs(segment);
+
+                for (size_t idx = 0; idx < segment.calls.size(); ++idx) {
+                    auto& call = segment.calls[idx];
+                    auto&& [method, new_method] = calls.try_emplace(call.function_id);
+                    if (new_method) method->function_name = call.function_name;
+                    bool inserted = false;
+                    auto& recorded = unprotected_emplace_call(*method, segment.keys[idx],
+                        m_snapshot->blobs.get(call.pre_call_args), inserted);
+                    if (inserted) {
+                        recorded.call = std::move(call);
+                        continue;
+                    }
+                    auto& results = recorded.call.results;
+                    std::move(call.results.begin(), call.results.end(),
+                        std::back_inserter(results));
+                }
+                callbacks.splice(callbacks.end(), segment.callbacks);
+            }
+
+            if (truncated) {
+                master().log_message(log_message_level::warning,
+                    "the recording of " + m_name +
+                        " ends with an incomplete segment, it's ignored");
+            }
+        }
+
+        void throw_other_version() const
+        {
+            throw std::runtime_error{"the recording of " + m_name +
+                " was made by another version of the library, it has to be recorded "
+                "again"};
+        }
+
+        void facade_load(std::shared_ptr<const utils::mapped_file> recording) override
+        {
+            t_lock_guard lg(m_mtx);
+            unprotected_own_snapshot();
+            const bool other_version = recording_format::has_other_version(
+                recording->data(), recording->size());
+            if (other_version) throw_other_version();
+            if (recording_format::is_streamed(*recording)) {
+                unprotected_load_streamed(*recording);
+            } else if constexpr (t_archive_policy::indexed_recording) {
+                unprotected_load_indexed(std::move(recording));
+            } else {
+                utils::memory_istream stream{recording->data(), recording->size()};
+                t_input_archive archive{stream};
+
+                std::string name;
+                archive(cereal::make_nvp("name", name));
+                check_recording_name(name);
+
+                // recordings made before the version was saved don't have it
+                int version = 0;
+                try {
+                    archive(cereal::make_nvp("version", version));
+                } catch (const cereal::Exception&) {
+                }
+                if (version != recording_format::version) throw_other_version();
+
+                archive(cereal::make_nvp("blobs", m_snapshot->blobs),
+                    cereal::make_nvp("calls", m_snapshot->calls),
+                    cereal::make_nvp("callbacks", m_snapshot->callbacks));
+            }
+            m_snapshot->archive_policy = &archive_policy_tag<t_archive_policy>;
+            m_snapshot->index_calls();
+            release_cursors();
+        }
+
+        bool facade_replay_snapshot(std::shared_ptr<recording_snapshot> snapshot) override
+        {
+            if (snapshot->archive_policy != &archive_policy_tag<t_archive_policy>) {
+                return false;
+            }
+            t_lock_guard lg(m_mtx);
+            m_snapshot = std::move(snapshot);
+            release_cursors();
+            return true;
+        }
+
+        void unprotected_decode(recorded_call& call)
+        {
+            if (call.decoded.load(std::memory_order_relaxed)) return;
+            recording_format::read_blob<t_archive_policy>(
+                *m_snapshot->recording, call.encoded, call.call);
+            call.decoded.store(true, std::memory_order_release);
+        }
+
+        const function_call& decoded_call(recorded_call& call)
+        {
+            if (!call.decoded.load(std::memory_order_acquire)) {
+                std::lock_guard<std::mutex> lg(m_snapshot->mtx);
+                unprotected_decode(call);
+            }
+            return call.call;
+        }
+
+        void decode_recorded_call(recorded_call& call) override { decoded_call(call); }
+
+        void unprotected_save_indexed(std::ostream& stream)
+        {
+            std::lock_guard<std::mutex> decoding_lg(m_snapshot->mtx);
+            recording_format::writer<t_archive_policy> writer{stream};
+            recording_format::index recording_index;
+            recording_index.name = m_name;
+            for (size_t id = 1; id <= m_snapshot->blobs.size(); ++id) {
+                recording_index.blobs.push_back(
+                    writer.write_raw(m_snapshot->blobs.get(static_cast<t_blob_id>(id))));
+            }
+            for (auto& [id, method] : m_snapshot->calls) {
+                for (auto& [key, call] : method.calls) {
+                    unprotected_decode(call);
+                    recording_index.calls.push_back(
+                        {method.function_name, key, writer.write_blob(call.call)});
+                }
+            }
+            recording_index.callbacks = writer.write_blob(m_snapshot->callbacks);
+            writer.finish(recording_index);
+        }
+
         template <typename... t_args>
         void restore_args(std::string& recorded, t_args&&... args)
         {
             std::stringstream ss{recorded};
             {
-                t_cereal_input_archive archive{ss};
+                t_input_archive archive{ss};
                 utils::visit_args(archive, std::forward<t_args>(args)...);
             }
         }
 
+        // decodes the result into its cache by the first replay
+        template <typename t_ret, typename... t_args, typename t_ctx>
+        const auto* cached_result(t_ctx& ctx, const function_result& result)
+        {
+            using t_values = utils::decoded_values<t_ret, t_args...>;
+            const stage_timer decoding{ctx.counters, &method_counters::decoding_ns};
+            const auto& blobs = m_snapshot->blobs;
+            return result.decoded.emplace<t_values>([&](t_values& values) {
+                values.has_post_call_args = result.post_call_args != 0;
+                std::apply(
+                    [&](auto&... post_call_args) {
+                        unpack<t_archive_policy>(ctx.function_name,
+                            blobs.get(result.post_call_args), post_call_args...);
+                    },
+                    values.post_call_args);
+                if constexpr (!std::is_same<t_ret, void>::value) {
+                    unpack<t_archive_policy>(
+                        ctx.function_name, blobs.get(result.return_value), values.ret);
+                }
+            });
+        }
+
+        template <typename t_ret, typename t_ctx, typename t_values, typename... t_args>
+        typename std::decay<t_ret>::type replay_cached_result(
+            t_ctx& ctx, const t_values& values, t_args&&... args)
+        {
+            if (values.has_post_call_args) {
+                std::apply(
+                    [&](const auto&... post_call_args) {
+                        (utils::assign_out_arg(args, post_call_args), ...);
+                    },
+                    values.post_call_args);
+            }
+            if constexpr (std::is_same<t_ret, void>::value) {
+                if (ctx.overrider) { ctx.overrider(std::forward<t_args>(args)...); }
+            } else {
+                if (ctx.overrider) return ctx.overrider(std::forward<t_args>(args)...);
+                return values.ret;
+            }
+        }
+
+        // The calls of a method with a filter are recorded with the key of the
+        // filtered arguments, so they are filtered and serialized to be looked up
+        template <typename t_ctx, typename... t_args>
+        recorded_call* find_recorded_call(t_ctx& ctx, t_args&... args)
+        {
+            auto* method = m_snapshot->calls.find(ctx.function_id);
+            if (!method) return nullptr;
+            t_call_key key{0};
+            std::string pre_call_args;
+            const bool filtered = static_cast<bool>(ctx.filter_and_record);
+            if (filtered) {
+                record_args_with_filter(ctx, pre_call_args, &key, args...);
+            } else {
+                const stage_timer hashing{ctx.counters, &method_counters::hashing_ns};
+                key = calculate_key(args...);
+            }
+            auto* found = method->calls.find(key);
+            if (!found || !found->shared_key) return found;
+
+            // other arguments have the same key, the recorded ones are compared
+            if (!filtered) {
+                const stage_timer serialization{
+                    ctx.counters, &method_counters::serialization_ns};
+                record_args<t_archive_policy>(pre_call_args, args...);
+            }
+            for (; found; found = method->calls.find(key)) {
+                const auto& recorded = decoded_call(*found).pre_call_args;
+                if (m_snapshot->blobs.get(recorded) == pre_call_args) return found;
+                key = next_call_key(key);
+            }
+            return nullptr;
+        }
+
+        // returned by a call that can't be replayed or made
+        template <typename t_ret>
+        static typename std::decay<t_ret>::type missing_result()
+        {
+            if constexpr (!std::is_same<t_ret, void>::value) return {};
+        }
+
         template <typename t_ret, typename t_ctx, typename... t_args>
         typename std::decay<t_ret>::type replay_function_call(
             t_ctx& ctx, t_args&&... args)
+        {
+            auto* this_method_call = find_recorded_call(ctx, args...);
+            if (!this_method_call) {
+                add_to_counter(ctx.counters, &method_counters::misses);
+                return missing_result<t_ret>();
+            }
+            return replay_recorded_call<t_ret>(
+                ctx, *this_method_call, std::forward<t_args>(args)...);
+        }
+
+        template <typename t_ret, typename t_ctx, typename... t_args>
+        typename std::decay<t_ret>::type replay_recorded_call(
+            t_ctx& ctx, recorded_call& this_method_call, t_args&&... args)
         {
             constexpr const bool has_return = !std::is_same<t_ret, void>::value;
-            const auto method_it = m_calls.find(ctx.function_name);
-            if (method_it == m_calls.end()) {
-                if constexpr (has_return) {
-                    return {};
-                } else {
-                    return;
-                }
+            add_to_counter(ctx.counters, &method_counters::hits);
+            const function_result* found_result;
+            {
+                const stage_timer decoding{ctx.counters, &method_counters::decoding_ns};
+                found_result =
+                    &decoded_call(this_method_call)
+                         .get_next_result(m_selection, replay_cursor(this_method_call));
             }
-            std::string pre_call_args;
-            record_args(pre_call_args, std::forward<t_args>(args)...);
-            const auto hash = calculate_hash(pre_call_args);
-            const auto& this_method_calls = method_it->second;
-            const auto this_method_call_it = this_method_calls.find(hash);
-            if (this_method_call_it == method_it->second.end()) {
-                if constexpr (has_return) {
-                    return {};
-                } else {
-                    return;
+            const auto& this_method_call_result = *found_result;
+            {
+                const stage_timer delay{ctx.counters, &method_counters::replay_delay_ns};
+                master().replay_duration(this_method_call_result.duration);
+            }
+            if constexpr (utils::is_cacheable_result<t_ret, t_args...>::value) {
+                if (const auto* values = cached_result<t_ret, t_args...>(
+                        ctx, this_method_call_result)) {
+                    return replay_cached_result<t_ret>(
+                        ctx, *values, std::forward<t_args>(args)...);
                 }
             }
-            const auto& this_method_call_result =
-                this_method_call_it->second.get_next_result(m_selection);
-            std::this_thread::sleep_for(t_duration{this_method_call_result.duration});
-            unpack(ctx.function_name, this_method_call_result.post_call_args,
-                std::forward<t_args>(args)...);
+            {
+                const stage_timer decoding{ctx.counters, &method_counters::decoding_ns};
+                unpack<t_archive_policy>(ctx.function_name,
+                    m_snapshot->blobs.get(this_method_call_result.post_call_args),
+                    std::forward<t_args>(args)...);
+            }
             if constexpr (!has_return) {
                 if (ctx.overrider) { ctx.overrider(std::forward<t_args>(args)...); }
             } else {
                 typename std::decay<t_ret>::type ret{};
-                unpack(ctx.function_name, this_method_call_result.return_value, ret);
+                {
+                    const stage_timer decoding{
+                        ctx.counters, &method_counters::decoding_ns};
+                    unpack<t_archive_policy>(ctx.function_name,
+                        m_snapshot->blobs.get(this_method_call_result.return_value), ret);
+                }
                 if (ctx.overrider) { ret = ctx.overrider(std::forward<t_args>(args)...); }
                 return ret;
             }
         }
 
-        void insert_method_call(const std::string& method_name,
-            std::string& pre_call_args, function_result&& result)
+        void insert_method_call(t_method_id id, const char* method_name, t_call_key key,
+            std::string& pre_call_args, recorded_result&& result,
+            method_counters* counters)
         {
-            const auto hash = calculate_hash(pre_call_args);
-            t_lock_guard lg(m_mtx);
-            auto& method_calls = m_calls[method_name];
-            auto method_call_it = method_calls.find(hash);
-            if (method_call_it == method_calls.end()) {
-                function_call function_call;
-                function_call.function_name = method_name;
-                function_call.pre_call_args = std::move(pre_call_args);
-                method_call_it =
-                    method_calls.insert({hash, std::move(function_call)}).first;
-            }
-
-            method_call_it->second.results.emplace_back(std::move(result));
+            append_pending_call({false, id, method_name, key, std::move(pre_call_args),
+                                    std::move(result)},
+                counters);
         }
 
-        void insert_callback_call(const std::string& function_name,
-            std::string& pre_call_args, function_result&& result)
+        void insert_callback_call(t_method_id id, const char* function_name, t_call_key,
+            std::string& pre_call_args, recorded_result&& result,
+            method_counters* counters)
         {
-            t_lock_guard lg(m_mtx);
-            function_call callback_call;
-            callback_call.function_name = function_name;
-            callback_call.pre_call_args = std::move(pre_call_args);
-            callback_call.results.emplace_back(std::move(result));
-            m_callbacks.emplace_back(std::move(callback_call));
+            append_pending_call({true, id, function_name, 0, std::move(pre_call_args),
+                                    std::move(result)},
+                counters);
         }
 
+        // key is set to the key of the recorded arguments unless it's nullptr
         template <typename t_ctx, typename... t_args>
-        void record_args_with_filter(t_ctx& ctx, std::string& recording, t_args&&... args)
+        void record_args_with_filter(
+            t_ctx& ctx, std::string& recording, t_call_key* key, t_args&&... args)
         {
             if (!ctx.filter_and_record) {
-                record_args(recording, std::forward<t_args>(args)...);
+                if (key) {
+                    const stage_timer hashing{ctx.counters, &method_counters::hashing_ns};
+                    *key = calculate_key(args...);
+                }
+                const stage_timer serialization{
+                    ctx.counters, &method_counters::serialization_ns};
+                record_args<t_archive_policy>(recording, std::forward<t_args>(args)...);
                 return;
             }
 
-            ctx.filter_and_record(recording, std::forward<t_args>(args)...);
+            // filtered arguments are hashed while they are serialized
+            const stage_timer serialization{
+                ctx.counters, &method_counters::serialization_ns};
+            ctx.filter_and_record(recording, key, std::forward<t_args>(args)...);
         }
 
-        template <typename t_ret, typename t_ctx, typename... t_args>
-        typename std::decay<t_ret>::type call_function_and_record(t_ctx& ctx,
-            const std::function<t_method_record_inserter>& inserter, t_args&&... args)
+        // copies of arguments and of the return value are serialized on the
+        // serializer thread, so all of them have to be copyable
+        template <typename t_value>
+        static constexpr bool is_copyable_value =
+            std::is_copy_constructible<typename std::decay<t_value>::type>::value &&
+            std::is_default_constructible<typename std::decay<t_value>::type>::value;
+
+        template <typename t_ret, typename... t_args>
+        static constexpr bool is_async_recordable =
+            (std::is_void<t_ret>::value || is_copyable_value<t_ret>) &&
+            (std::is_copy_constructible<typename std::decay<t_args>::type>::value && ...);
+
+        template <typename t_ret, typename t_ctx, typename t_inserter, typename... t_args>
+        typename std::decay<t_ret>::type call_function_and_record_async(
+            t_ctx& ctx, const t_inserter& inserter, t_args&&... args)
+        {
+            using t_args_tuple = std::tuple<typename std::decay<t_args>::type...>;
+            using t_result = typename std::decay<t_ret>::type;
+            constexpr bool has_return = !std::is_same<t_ret, void>::value;
+
+            t_args_tuple pre_call_args{args...};
+            const auto offset = master().get_offset_from_origin();
+            utils::timer timer;
+            std::conditional_t<has_return, t_result, bool> ret{};
+            if constexpr (has_return) {
+                ret = ctx.function(std::forward<t_args>(args)...);
+            } else {
+                ctx.function(std::forward<t_args>(args)...);
+            }
+            const auto duration = timer.get_duration<t_duration>();
+            add_to_counter(
+                ctx.counters, &method_counters::implementation_ns, duration);
+            t_args_tuple post_call_args{args...};
+
+            // the stages of the job are counted by the serializer thread
+            auto serialize_args = [filter = ctx.filter_and_record,
+                                      counters = ctx.counters](std::string& recording,
+                                      t_call_key* key, t_args_tuple& args_tuple) {
+                std::apply(
+                    [&](auto&... values) {
+                        if (filter) {
+                            const stage_timer serialization{
+                                counters, &method_counters::serialization_ns};
+                            filter(recording, key, values...);
+                            return;
+                        }
+                        if (key) {
+                            const stage_timer hashing{
+                                counters, &method_counters::hashing_ns};
+                            *key = calculate_key(values...);
+                        }
+                        const stage_timer serialization{
+                            counters, &method_counters::serialization_ns};
+                        record_args<t_archive_policy>(recording, values...);
+                    },
+                    args_tuple);
+            };
+
+            auto job = [inserter, serialize_args, ret, offset, duration,
+                           function_id = ctx.function_id,
+                           function_name = ctx.function_name, counters = ctx.counters,
+                           pre_call_args = std::move(pre_call_args),
+                           post_call_args = std::move(post_call_args)]() mutable {
+                std::string recorded_pre_call_args;
+                t_call_key key{0};
+                serialize_args(recorded_pre_call_args, &key, pre_call_args);
+                recorded_result result;
+                result.offest_from_origin = offset;
+                result.duration = duration;
+                if constexpr (has_return) {
+                    const stage_timer serialization{
+                        counters, &method_counters::serialization_ns};
+                    record_args<t_archive_policy>(result.return_value, ret);
+                }
+                serialize_args(result.post_call_args, nullptr, post_call_args);
+                inserter(function_id, function_name, key, recorded_pre_call_args,
+                    std::move(result), counters);
+            };
+            // the call is not recorded if the serializer drops it
+            master().serialize_async(std::move(job));
+
+            if constexpr (has_return) { return ret; }
+        }
+
+        template <typename t_ret, typename t_ctx, typename t_inserter, typename... t_args>
+        typename std::decay<t_ret>::type call_function_and_record(
+            t_ctx& ctx, const t_inserter& inserter, t_args&&... args)
         {
             if (!ctx.static_function && !m_impl) {
                 throw std::runtime_error{
                     std::string{"implementation is not set for "} + facade_name()};
             }
+            if constexpr (is_async_recordable<t_ret, t_args...>) {
+                if (master().is_serializing_async()) {
+                    return call_function_and_record_async<t_ret>(
+                        ctx, inserter, std::forward<t_args>(args)...);
+                }
+            }
             std::string pre_call_args;
-            record_args_with_filter(ctx, pre_call_args, std::forward<t_args>(args)...);
-            function_result this_call_result;
+            t_call_key key{0};
+            record_args_with_filter(
+                ctx, pre_call_args, &key, std::forward<t_args>(args)...);
+            recorded_result this_call_result;
             this_call_result.offest_from_origin = master().get_offset_from_origin();
             utils::timer timer;
             std::any ret;
             constexpr bool has_return = !std::is_same<t_ret, void>::value;
             if constexpr (has_return) {
                 ret = ctx.function(std::forward<t_args>(args)...);
-                record_args(this_call_result.return_value, std::any_cast<t_ret>(ret));
             } else {
                 ctx.function(std::forward<t_args>(args)...);
             }
             this_call_result.duration = timer.get_duration<t_duration>();
-            record_args_with_filter(
-                ctx, this_call_result.post_call_args, std::forward<t_args>(args)...);
-            inserter(ctx.function_name, pre_call_args, std::move(this_call_result));
+            add_to_counter(ctx.counters, &method_counters::implementation_ns,
+                this_call_result.duration);
+            if constexpr (has_return) {
+                const stage_timer serialization{
+                    ctx.counters, &method_counters::serialization_ns};
+                record_args<t_archive_policy>(
+                    this_call_result.return_value, std::any_cast<t_ret>(ret));
+            }
+            record_args_with_filter(ctx, this_call_result.post_call_args, nullptr,
+                std::forward<t_args>(args)...);
+            inserter(ctx.function_id, ctx.function_name, key, pre_call_args,
+                std::move(this_call_result), ctx.counters);
             if constexpr (has_return) { return std::any_cast<t_ret>(ret); }
         }
 
@@ -646,35 +1923,82 @@ namespace facade
         template <typename t_ret, typename t_ctx, typename... t_args>
         typename std::decay<t_ret>::type call_method(t_ctx& ctx, t_args&&... args)
         {
-            if (is_playing()) {
+            const auto scope = master().enter_call();
+            ctx.counters = nullptr;
+            if (scope.mode() != facade_mode::passthrough &&
+                master().is_collecting_stats()) {
+                ctx.counters = &method_counters_of(ctx.function_id, ctx.function_name);
+            }
+            add_to_counter(ctx.counters, &method_counters::calls);
+            const stage_timer call_timer{ctx.counters, &method_counters::total_ns};
+            if (scope.mode() == facade_mode::playing) {
                 return replay_function_call<t_ret>(ctx, std::forward<t_args>(args)...);
             }
-            if (is_recording()) {
-                auto inserter = [this](const std::string& method_name,
-                                    std::string& pre_call_args,
-                                    function_result&& result) -> void {
-                    insert_method_call(method_name, pre_call_args, std::move(result));
-                };
-                return call_function_and_record<t_ret>(
-                    ctx, inserter, std::forward<t_args>(args)...);
+            if (scope.mode() == facade_mode::hybrid) {
+                return replay_or_record_function_call<t_ret>(
+                    ctx, std::forward<t_args>(args)...);
+            }
+            if (scope.mode() == facade_mode::recording) {
+                return record_function_call<t_ret>(ctx, std::forward<t_args>(args)...);
             } else {
                 return pass_through<t_ret>(ctx, std::forward<t_args>(args)...);
             }
         }
 
+        template <typename t_ret, typename t_ctx, typename... t_args>
+        typename std::decay<t_ret>::type record_function_call(
+            t_ctx& ctx, t_args&&... args)
+        {
+            if (!should_record(ctx)) {
+                return pass_through<t_ret>(ctx, std::forward<t_args>(args)...);
+            }
+            auto inserter = [this](t_method_id id, const char* method_name,
+                                t_call_key key, std::string& pre_call_args,
+                                recorded_result&& result,
+                                method_counters* counters) -> void {
+                insert_method_call(
+                    id, method_name, key, pre_call_args, std::move(result), counters);
+            };
+            return call_function_and_record<t_ret>(
+                ctx, inserter, std::forward<t_args>(args)...);
+        }
+
+        // a call missing in the recording is made and recorded if the facade has an
+        // implementation to make it
+        template <typename t_ret, typename t_ctx, typename... t_args>
+        typename std::decay<t_ret>::type replay_or_record_function_call(
+            t_ctx& ctx, t_args&&... args)
+        {
+            if (auto* this_method_call = find_recorded_call(ctx, args...)) {
+                return replay_recorded_call<t_ret>(
+                    ctx, *this_method_call, std::forward<t_args>(args)...);
+            }
+            add_to_counter(ctx.counters, &method_counters::misses);
+            if (!ctx.static_function && !m_impl) return missing_result<t_ret>();
+            return record_function_call<t_ret>(ctx, std::forward<t_args>(args)...);
+        }
+
         template <typename t_ret, typename t_ctx, typename... t_args>
         typename std::decay<t_ret>::type call_callback(t_ctx& ctx, t_args&&... args)
         {
-            if (is_playing()) {
+            const auto scope = master().enter_call();
+            if (scope.mode() == facade_mode::playing) {
                 throw std::runtime_error(
                     "call_callback is not expected to be called during m_playing == "
                     "true");
             }
-            if (is_recording()) {
-                auto inserter = [this](const std::string& method_name,
-                                    std::string& pre_call_args,
-                                    function_result&& result) -> void {
-                    insert_callback_call(method_name, pre_call_args, std::move(result));
+            // callbacks of an implementation making missed calls go to the client,
+            // the recorded ones are replayed at their offsets
+            if (scope.mode() == facade_mode::hybrid) {
+                return pass_through<t_ret>(ctx, std::forward<t_args>(args)...);
+            }
+            if (scope.mode() == facade_mode::recording) {
+                auto inserter = [this](t_method_id id, const char* method_name,
+                                    t_call_key key, std::string& pre_call_args,
+                                    recorded_result&& result,
+                                    method_counters* counters) -> void {
+                    insert_callback_call(id, method_name, key, pre_call_args,
+                        std::move(result), counters);
                 };
                 return call_function_and_record<t_ret>(
                     ctx, inserter, std::forward<t_args>(args)...);
@@ -695,12 +2019,66 @@ namespace facade
         using t_impl_type = t_type;
         using t_const_impl_type = typename std::add_const<t_type>::type;
 
+        size_t facade_flush(std::ostream& stream) override
+        {
+            t_lock_guard lg(m_mtx);
+            unprotected_merge_pending_calls();
+            unprotected_restore_result_order();
+            if (m_snapshot->calls.empty() && m_snapshot->callbacks.empty()) return 0;
+            if (m_evicted_results != 0) unprotected_compact_blobs();
+
+            recording_segment segment;
+            segment.name = m_name;
+            segment.blobs = std::move(m_snapshot->blobs);
+            m_snapshot->blobs.clear();
+            m_evicted_results = 0;
+            for (auto& [id, method] : m_snapshot->calls) {
+                for (auto& [key, call] : method.calls) {
+                    segment.keys.push_back(key);
+                    segment.calls.emplace_back(std::move(call.call));
+                }
+            }
+            segment.callbacks = std::move(m_snapshot->callbacks);
+            m_snapshot->calls.clear();
+            m_snapshot->callbacks.clear();
+
+            recording_format::write_segment<t_archive_policy>(stream, segment);
+            return std::exchange(m_unflushed_bytes, 0);
+        }
+
+        void facade_save(std::ostream& stream) override
+        {
+            t_lock_guard lg(m_mtx);
+            unprotected_merge_pending_calls();
+            unprotected_restore_result_order();
+            if (m_evicted_results != 0 && !m_snapshot->recording) {
+                unprotected_compact_blobs();
+            }
+            if constexpr (t_archive_policy::indexed_recording) {
+                unprotected_save_indexed(stream);
+            } else {
+                t_output_archive archive{stream};
+                archive(cereal::make_nvp("name", m_name),
+                    cereal::make_nvp(
+                        "version", static_cast<int>(recording_format::version)),
+                    cereal::make_nvp("blobs", m_snapshot->blobs),
+                    cereal::make_nvp("calls", m_snapshot->calls),
+                    cereal::make_nvp("callbacks", m_snapshot->callbacks));
+            }
+        }
+
+        // facade_save and facade_load are implemented at this level so the facade has
+        // to be registered after and unregistered before this part of the object
+        // exists, otherwise master would call them on a partially built object
         facade(std::string name, bool register_on_consturction)
-            : facade_base(std::move(name), register_on_consturction)
+            : facade_base(std::move(name))
         {
+            if (register_on_consturction) internal_register();
         }
 
-        facade(std::string name) : facade_base(std::move(name), true) {}
+        facade(std::string name) : facade(std::move(name), true) {}
+
+        ~facade() { internal_unregister(); }
     };
 }  // namespace facade
 
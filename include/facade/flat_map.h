@@ -0,0 +1,126 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "hash.h"
+
+namespace facade
+{
+    namespace utils
+    {
+        // Open-addressing hash table for integer keys. Entries are stored
+        // contiguously in insertion order, the probing table only holds keys and
+        // indices of the entries so a lookup touches one or two cache lines.
+        // Entries can't be erased, recordings only grow until they are cleared.
+        template <typename t_key, typename t_value>
+        class flat_map
+        {
+            static_assert(
+                std::is_integral<t_key>::value, "flat_map keys must be integral");
+
+        public:
+            using value_type = std::pair<t_key, t_value>;
+            using iterator = typename std::vector<value_type>::iterator;
+            using const_iterator = typename std::vector<value_type>::const_iterator;
+
+        private:
+            static constexpr uint32_t empty_slot = std::numeric_limits<uint32_t>::max();
+
+            struct slot
+            {
+                t_key key{};
+                uint32_t index{empty_slot};
+            };
+
+            std::vector<slot> m_slots;
+            std::vector<value_type> m_entries;
+            size_t m_mask{0};
+
+            size_t slot_of(t_key key) const
+            {
+                return static_cast<size_t>(mix64(static_cast<uint64_t>(key))) & m_mask;
+            }
+
+            void rehash(size_t slots_num)
+            {
+                std::vector<slot> slots(slots_num);
+                m_mask = slots_num - 1;
+                for (uint32_t index = 0; index < m_entries.size(); ++index) {
+                    size_t pos = slot_of(m_entries[index].first);
+                    while (slots[pos].index != empty_slot) pos = (pos + 1) & m_mask;
+                    slots[pos] = slot{m_entries[index].first, index};
+                }
+                m_slots = std::move(slots);
+            }
+
+            void grow_if_needed()
+            {
+                // keep the load factor under 1/2, probe sequences stay very short
+                if ((m_entries.size() + 1) * 2 <= m_slots.size()) return;
+                rehash(m_slots.empty() ? 16 : m_slots.size() * 2);
+            }
+
+        public:
+            const t_value* find(t_key key) const
+            {
+                if (m_slots.empty()) return nullptr;
+                size_t pos = slot_of(key);
+                while (true) {
+                    const auto& this_slot = m_slots[pos];
+                    if (this_slot.index == empty_slot) return nullptr;
+                    if (this_slot.key == key) return &m_entries[this_slot.index].second;
+                    pos = (pos + 1) & m_mask;
+                }
+            }
+
+            t_value* find(t_key key)
+            {
+                const auto& const_this = *this;
+                return const_cast<t_value*>(const_this.find(key));
+            }
+
+            template <typename... t_args>
+            std::pair<t_value*, bool> try_emplace(t_key key, t_args&&... args)
+            {
+                if (auto* found = find(key)) return {found, false};
+                grow_if_needed();
+                size_t pos = slot_of(key);
+                while (m_slots[pos].index != empty_slot) pos = (pos + 1) & m_mask;
+                m_slots[pos] = slot{key, static_cast<uint32_t>(m_entries.size())};
+                m_entries.emplace_back(std::piecewise_construct,
+                    std::forward_as_tuple(key),
+                    std::forward_as_tuple(std::forward<t_args>(args)...));
+                return {&m_entries.back().second, true};
+            }
+
+            t_value& operator[](t_key key) { return *try_emplace(key).first; }
+
+            void reserve(size_t entries_num)
+            {
+                m_entries.reserve(entries_num);
+                size_t slots_num = 16;
+                while (slots_num < entries_num * 2) slots_num *= 2;
+                if (slots_num > m_slots.size()) rehash(slots_num);
+            }
+
+            void clear()
+            {
+                m_slots.clear();
+                m_entries.clear();
+                m_mask = 0;
+            }
+
+            size_t size() const { return m_entries.size(); }
+            bool empty() const { return m_entries.empty(); }
+
+            iterator begin() { return m_entries.begin(); }
+            iterator end() { return m_entries.end(); }
+            const_iterator begin() const { return m_entries.begin(); }
+            const_iterator end() const { return m_entries.end(); }
+        };
+    }  // namespace utils
+}  // namespace facade
@@ -0,0 +1,176 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace facade
+{
+    namespace utils
+    {
+        // 64-bit non-cryptographic hash (xxHash64), used to fingerprint recorded
+        // arguments. It's fast enough to run on every replayed call and its
+        // collision rate is negligible for the number of calls in a recording
+        namespace xxh64
+        {
+            constexpr uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+            constexpr uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+            constexpr uint64_t prime3 = 0x165667B19E3779F9ULL;
+            constexpr uint64_t prime4 = 0x85EBCA77C2B2AE63ULL;
+            constexpr uint64_t prime5 = 0x27D4EB2F165667C5ULL;
+
+            inline uint64_t rotl(uint64_t value, int bits)
+            {
+                return (value << bits) | (value >> (64 - bits));
+            }
+
+            inline uint64_t read64(const unsigned char* ptr)
+            {
+                uint64_t value;
+                std::memcpy(&value, ptr, sizeof(value));
+                return value;
+            }
+
+            inline uint32_t read32(const unsigned char* ptr)
+            {
+                uint32_t value;
+                std::memcpy(&value, ptr, sizeof(value));
+                return value;
+            }
+
+            inline uint64_t round(uint64_t acc, uint64_t input)
+            {
+                acc += input * prime2;
+                acc = rotl(acc, 31);
+                return acc * prime1;
+            }
+
+            inline uint64_t merge_round(uint64_t acc, uint64_t value)
+            {
+                acc ^= round(0, value);
+                return acc * prime1 + prime4;
+            }
+
+            inline uint64_t avalanche(uint64_t hash)
+            {
+                hash ^= hash >> 33;
+                hash *= prime2;
+                hash ^= hash >> 29;
+                hash *= prime3;
+                hash ^= hash >> 32;
+                return hash;
+            }
+        }  // namespace xxh64
+
+        inline uint64_t hash64(const void* data, size_t size, uint64_t seed = 0)
+        {
+            using namespace xxh64;
+            const auto* ptr = static_cast<const unsigned char*>(data);
+            const auto* const end = ptr + size;
+            uint64_t hash;
+
+            if (size >= 32) {
+                const auto* const limit = end - 32;
+                uint64_t v1 = seed + prime1 + prime2;
+                uint64_t v2 = seed + prime2;
+                uint64_t v3 = seed;
+                uint64_t v4 = seed - prime1;
+                do {
+                    v1 = round(v1, read64(ptr));
+                    v2 = round(v2, read64(ptr + 8));
+                    v3 = round(v3, read64(ptr + 16));
+                    v4 = round(v4, read64(ptr + 24));
+                    ptr += 32;
+                } while (ptr <= limit);
+
+                hash = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+                hash = merge_round(hash, v1);
+                hash = merge_round(hash, v2);
+                hash = merge_round(hash, v3);
+                hash = merge_round(hash, v4);
+            } else {
+                hash = seed + prime5;
+            }
+
+            hash += static_cast<uint64_t>(size);
+
+            while (ptr + 8 <= end) {
+                hash ^= round(0, read64(ptr));
+                hash = rotl(hash, 27) * prime1 + prime4;
+                ptr += 8;
+            }
+
+            if (ptr + 4 <= end) {
+                hash ^= static_cast<uint64_t>(read32(ptr)) * prime1;
+                hash = rotl(hash, 23) * prime2 + prime3;
+                ptr += 4;
+            }
+
+            while (ptr < end) {
+                hash ^= (*ptr) * prime5;
+                hash = rotl(hash, 11) * prime1;
+                ++ptr;
+            }
+
+            return avalanche(hash);
+        }
+
+        inline uint64_t hash64(const std::string& data, uint64_t seed = 0)
+        {
+            return hash64(data.data(), data.size(), seed);
+        }
+
+        // Hash of a sequence of values fed one by one, each value is mixed in with a
+        // single xxHash64 round so hashing a few integers costs a few multiplications
+        class hash_builder
+        {
+            uint64_t m_hash{xxh64::prime5};
+
+        public:
+            void add(uint64_t value)
+            {
+                m_hash ^= xxh64::round(0, value);
+                m_hash = xxh64::rotl(m_hash, 27) * xxh64::prime1 + xxh64::prime4;
+            }
+
+            void add_bytes(const void* data, size_t size)
+            {
+                add(hash64(data, size));
+                add(static_cast<uint64_t>(size));
+            }
+
+            uint64_t finish() const { return xxh64::avalanche(m_hash); }
+        };
+
+        constexpr uint64_t fnv1a64(const char* str)
+        {
+            uint64_t hash = 0xCBF29CE484222325ULL;
+            while (*str) {
+                hash ^= static_cast<unsigned char>(*str++);
+                hash *= 0x100000001B3ULL;
+            }
+            return hash;
+        }
+
+        // Spreads integer keys that are not uniformly distributed on their own
+        inline uint64_t mix64(uint64_t key)
+        {
+            key ^= key >> 33;
+            key *= 0xFF51AFD7ED558CCDULL;
+            key ^= key >> 33;
+            key *= 0xC4CEB9FE1A85EC53ULL;
+            key ^= key >> 33;
+            return key;
+        }
+    }  // namespace utils
+
+    // Methods and callbacks of a facade are identified by a hash of their name that
+    // is computed at compile time by the FACADE_ macros
+    using t_method_id = uint64_t;
+
+    constexpr t_method_id method_id(const char* name) { return utils::fnv1a64(name); }
+
+    inline t_method_id method_id(const std::string& name)
+    {
+        return method_id(name.c_str());
+    }
+}  // namespace facade
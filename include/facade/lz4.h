@@ -0,0 +1,185 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace facade
+{
+    namespace utils
+    {
+        // Compressor and decompressor of the LZ4 block format. Recordings are very
+        // repetitive, a greedy single-probe match finder already shrinks them
+        // several times while compressing and decompressing at memory speeds. The
+        // output can be decoded by the reference LZ4 implementation too
+        namespace lz4
+        {
+            constexpr size_t min_match = 4;
+            // the last bytes of a block are always literals
+            constexpr size_t last_literals = 5;
+            // a match can't start closer to the end of a block
+            constexpr size_t match_limit = 12;
+            constexpr size_t max_offset = 65535;
+            constexpr int hash_log = 14;
+
+            // the compressed size of the worst case, incompressible input
+            inline size_t compress_bound(size_t size) { return size + size / 255 + 16; }
+
+            inline uint32_t read32(const unsigned char* ptr)
+            {
+                uint32_t value;
+                std::memcpy(&value, ptr, sizeof(value));
+                return value;
+            }
+
+            inline uint32_t hash4(uint32_t sequence)
+            {
+                return (sequence * 2654435761U) >> (32 - hash_log);
+            }
+
+            // writes the part of a literal or match length above the 4 bits of the
+            // token
+            inline unsigned char* write_length(unsigned char* out, size_t length)
+            {
+                for (; length >= 255; length -= 255) *out++ = 255;
+                *out++ = static_cast<unsigned char>(length);
+                return out;
+            }
+
+            inline unsigned char* write_literals(unsigned char* out,
+                const unsigned char* literals, size_t length, unsigned char*& token)
+            {
+                token = out++;
+                *token = static_cast<unsigned char>((length < 15 ? length : 15) << 4);
+                if (length >= 15) out = write_length(out, length - 15);
+                std::memcpy(out, literals, length);
+                return out + length;
+            }
+
+            // destination must have room for compress_bound(size) bytes, returns
+            // the compressed size
+            inline size_t compress(const char* source, size_t size, char* destination)
+            {
+                const auto* src = reinterpret_cast<const unsigned char*>(source);
+                auto* out = reinterpret_cast<unsigned char*>(destination);
+                const unsigned char* const end = src + size;
+                const unsigned char* anchor = src;
+                unsigned char* token = nullptr;
+
+                if (size > match_limit) {
+                    // positions of the last sequences with the same hash
+                    std::vector<uint32_t> table(size_t{1} << hash_log, 0);
+                    const unsigned char* const last_match_start = end - match_limit;
+                    const unsigned char* const match_end = end - last_literals;
+                    const unsigned char* ip = src;
+                    // the step grows while no match is found, incompressible data
+                    // is skipped over quickly
+                    size_t misses = 0;
+                    while (ip <= last_match_start) {
+                        const uint32_t sequence = read32(ip);
+                        uint32_t& slot = table[hash4(sequence)];
+                        const unsigned char* match = src + slot;
+                        slot = static_cast<uint32_t>(ip - src);
+                        if (match >= ip || static_cast<size_t>(ip - match) > max_offset ||
+                            read32(match) != sequence) {
+                            ip += 1 + (misses++ >> 6);
+                            continue;
+                        }
+                        misses = 0;
+
+                        while (ip > anchor && match > src && ip[-1] == match[-1]) {
+                            --ip;
+                            --match;
+                        }
+                        size_t match_length = min_match;
+                        while (ip + match_length < match_end &&
+                            ip[match_length] == match[match_length]) {
+                            ++match_length;
+                        }
+
+                        out = write_literals(
+                            out, anchor, static_cast<size_t>(ip - anchor), token);
+                        const auto offset = static_cast<uint16_t>(ip - match);
+                        *out++ = static_cast<unsigned char>(offset & 0xff);
+                        *out++ = static_cast<unsigned char>(offset >> 8);
+                        const size_t extra_length = match_length - min_match;
+                        *token |= static_cast<unsigned char>(
+                            extra_length < 15 ? extra_length : 15);
+                        if (extra_length >= 15) {
+                            out = write_length(out, extra_length - 15);
+                        }
+
+                        ip += match_length;
+                        anchor = ip;
+                    }
+                }
+
+                const auto rest = static_cast<size_t>(end - anchor);
+                out = write_literals(out, anchor, rest, token);
+                return static_cast<size_t>(
+                    out - reinterpret_cast<unsigned char*>(destination));
+            }
+
+            // returns false unless the source decodes to exactly size bytes, it
+            // never reads or writes out of the buffers even if the source is corrupted
+            inline bool decompress(
+                const char* source, size_t source_size, char* destination, size_t size)
+            {
+                const auto* ip = reinterpret_cast<const unsigned char*>(source);
+                const unsigned char* const ip_end = ip + source_size;
+                auto* const dst = reinterpret_cast<unsigned char*>(destination);
+                unsigned char* op = dst;
+                unsigned char* const op_end = dst + size;
+
+                const auto read_length = [&ip, ip_end](size_t& length) {
+                    unsigned char byte;
+                    do {
+                        if (ip == ip_end) return false;
+                        byte = *ip++;
+                        length += byte;
+                    } while (byte == 255);
+                    return true;
+                };
+
+                while (ip < ip_end) {
+                    const unsigned char token = *ip++;
+                    size_t literal_length = token >> 4;
+                    if (literal_length == 15 && !read_length(literal_length)) {
+                        return false;
+                    }
+                    if (literal_length > static_cast<size_t>(ip_end - ip) ||
+                        literal_length > static_cast<size_t>(op_end - op)) {
+                        return false;
+                    }
+                    std::memcpy(op, ip, literal_length);
+                    ip += literal_length;
+                    op += literal_length;
+                    // the last sequence has no match
+                    if (ip == ip_end) break;
+
+                    if (ip_end - ip < 2) return false;
+                    const size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+                    ip += 2;
+                    if (offset == 0 || offset > static_cast<size_t>(op - dst)) {
+                        return false;
+                    }
+                    size_t match_length = token & 15;
+                    if (match_length == 15 && !read_length(match_length)) return false;
+                    match_length += min_match;
+                    if (match_length > static_cast<size_t>(op_end - op)) return false;
+
+                    // a match closer than its length repeats the last offset bytes,
+                    // they are copied in chunks that don't overlap
+                    while (match_length != 0) {
+                        const size_t chunk =
+                            offset < match_length ? offset : match_length;
+                        std::memcpy(op, op - offset, chunk);
+                        op += chunk;
+                        match_length -= chunk;
+                    }
+                }
+                return op == op_end;
+            }
+        }  // namespace lz4
+    }  // namespace utils
+}  // namespace facade
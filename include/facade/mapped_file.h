@@ -0,0 +1,168 @@
+#pragma once
+#include <cstddef>
+#include <istream>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace facade
+{
+    namespace utils
+    {
+        // Read-only memory mapping of a whole file, the mapping is shared with other
+        // processes that map the same file so the pages come from the page cache.
+        // It can hold contents in memory instead, i.e. a decompressed recording
+        class mapped_file
+        {
+            const char* m_data{nullptr};
+            size_t m_size{0};
+            std::string m_contents;
+            bool m_in_memory{false};
+#ifdef _WIN32
+            HANDLE m_file{INVALID_HANDLE_VALUE};
+            HANDLE m_mapping{nullptr};
+#else
+            int m_fd{-1};
+#endif
+
+            void fail(const std::string& path, const char* what)
+            {
+                close();
+                throw std::runtime_error{
+                    std::string{"failed to map a recording ("} + what + "): " + path};
+            }
+
+            void close()
+            {
+                if (m_in_memory) {
+                    m_contents.clear();
+                    m_data = nullptr;
+                    m_size = 0;
+                    return;
+                }
+#ifdef _WIN32
+                if (m_data) UnmapViewOfFile(m_data);
+                if (m_mapping) CloseHandle(m_mapping);
+                if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+                m_mapping = nullptr;
+                m_file = INVALID_HANDLE_VALUE;
+#else
+                if (m_data) munmap(const_cast<char*>(m_data), m_size);
+                if (m_fd != -1) ::close(m_fd);
+                m_fd = -1;
+#endif
+                m_data = nullptr;
+                m_size = 0;
+            }
+
+        public:
+            explicit mapped_file(const std::string& path)
+            {
+#ifdef _WIN32
+                m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+                if (m_file == INVALID_HANDLE_VALUE) fail(path, "open");
+                LARGE_INTEGER size;
+                if (!GetFileSizeEx(m_file, &size)) fail(path, "size");
+                m_size = static_cast<size_t>(size.QuadPart);
+                if (m_size == 0) return;
+                m_mapping =
+                    CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                if (!m_mapping) fail(path, "mapping");
+                m_data = static_cast<const char*>(
+                    MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+                if (!m_data) fail(path, "view");
+#else
+                m_fd = ::open(path.c_str(), O_RDONLY);
+                if (m_fd == -1) fail(path, "open");
+                struct stat st;
+                if (fstat(m_fd, &st) != 0) fail(path, "stat");
+                m_size = static_cast<size_t>(st.st_size);
+                if (m_size == 0) return;
+                void* data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, m_fd, 0);
+                if (data == MAP_FAILED) {
+                    m_size = 0;
+                    fail(path, "mmap");
+                }
+                m_data = static_cast<const char*>(data);
+#endif
+            }
+
+            struct in_memory
+            {
+            };
+
+            mapped_file(in_memory, std::string contents)
+                : m_contents(std::move(contents)), m_in_memory(true)
+            {
+                m_data = m_contents.data();
+                m_size = m_contents.size();
+            }
+
+            mapped_file(const mapped_file&) = delete;
+            mapped_file& operator=(const mapped_file&) = delete;
+
+            ~mapped_file() { close(); }
+
+            const char* data() const { return m_data; }
+            size_t size() const { return m_size; }
+        };
+
+        // Read-only stream buffer over a memory region, used to run cereal input
+        // archives directly over mapped recordings without copying them
+        class memory_streambuf : public std::streambuf
+        {
+        public:
+            memory_streambuf(const char* data, size_t size)
+            {
+                auto* begin = const_cast<char*>(data);
+                setg(begin, begin, begin + size);
+            }
+
+        protected:
+            pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                std::ios_base::openmode which = std::ios_base::in) override
+            {
+                if (!(which & std::ios_base::in)) return pos_type(off_type(-1));
+                char* base = eback();
+                if (dir == std::ios_base::cur) {
+                    off += gptr() - base;
+                } else if (dir == std::ios_base::end) {
+                    off += egptr() - base;
+                }
+                if (off < 0 || off > egptr() - base) return pos_type(off_type(-1));
+                setg(base, base + off, egptr());
+                return pos_type(off);
+            }
+
+            pos_type seekpos(pos_type pos, std::ios_base::openmode which) override
+            {
+                return seekoff(off_type(pos), std::ios_base::beg, which);
+            }
+        };
+
+        class memory_istream : public std::istream
+        {
+            memory_streambuf m_buf;
+
+        public:
+            memory_istream(const char* data, size_t size)
+                : std::istream(nullptr), m_buf(data, size)
+            {
+                rdbuf(&m_buf);
+            }
+        };
+    }  // namespace utils
+}  // namespace facade
@@ -1,18 +1,26 @@
 #ifndef MASTER_H
 #define MASTER_H
 #pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <cmath>
 #include <condition_variable>
+#include <exception>
 #include <fstream>
 #include <functional>
+#include <future>
 #include <map>
 #include <memory>
 #include <set>
+#include <sstream>
+#include <stdexcept>
 #include <string>
 #include <thread>
 #include <vector>
 
-#ifdef __cpp_lib_filesystem
+#if __has_include(<filesystem>)
 #include <filesystem>
 #else
 #include <experimental/filesystem>
@@ -24,6 +32,14 @@ namespace std
 }  // namespace std
 #endif
 
+#include "blob_store.h"
+#include "compression.h"
+#include "hash.h"
+#include "mapped_file.h"
+#include "recording.h"
+#include "recording_policy.h"
+#include "serializer.h"
+#include "stats.h"
 #include "utils.h"
 #include "worker_pool.h"
 
@@ -50,33 +66,176 @@ namespace facade
         cycle
     };
 
+    // Typed copy of the values of a recorded result, made by the first replay of the
+    // result so the later ones don't decode them again. The copy is published once
+    // and never replaced, it's read without a lock. A call site whose types differ
+    // from the cached ones decodes the recorded text as before
+    class decoded_result_cache
+    {
+        struct entry
+        {
+            const void* type;
+            virtual ~entry() = default;
+        };
+
+        template <typename t_values>
+        struct typed_entry : entry
+        {
+            t_values values;
+        };
+
+        // the address of the variable identifies the type, without RTTI
+        template <typename t_values>
+        static constexpr char type_tag{0};
+
+        mutable std::atomic<const entry*> m_entry{nullptr};
+
+        void reset() { delete m_entry.exchange(nullptr); }
+
+    public:
+        decoded_result_cache() = default;
+        // a copied result is decoded again by its first replay
+        decoded_result_cache(const decoded_result_cache&) {}
+        decoded_result_cache(decoded_result_cache&& that) noexcept
+            : m_entry(that.m_entry.exchange(nullptr))
+        {
+        }
+        decoded_result_cache& operator=(const decoded_result_cache& that)
+        {
+            if (this != &that) reset();
+            return *this;
+        }
+        decoded_result_cache& operator=(decoded_result_cache&& that) noexcept
+        {
+            if (this != &that) {
+                reset();
+                m_entry = that.m_entry.exchange(nullptr);
+            }
+            return *this;
+        }
+        ~decoded_result_cache() { reset(); }
+
+        // nullptr if nothing is cached or the cached values are of other types
+        template <typename t_values>
+        const t_values* find() const
+        {
+            const entry* cached = m_entry.load(std::memory_order_acquire);
+            if (!cached || cached->type != &type_tag<t_values>) return nullptr;
+            return &static_cast<const typed_entry<t_values>*>(cached)->values;
+        }
+
+        // decodes the values with decoder(t_values&) unless they are cached already,
+        // concurrent first replays may both decode, only one copy is kept
+        template <typename t_values, typename t_decoder>
+        const t_values* emplace(const t_decoder& decoder) const
+        {
+            if (const auto* values = find<t_values>()) return values;
+            auto decoded = std::make_unique<typed_entry<t_values>>();
+            decoded->type = &type_tag<t_values>;
+            decoder(decoded->values);
+            const entry* expected = nullptr;
+            if (!m_entry.compare_exchange_strong(
+                    expected, decoded.get(), std::memory_order_acq_rel)) {
+                // lost the race or the cache holds other types
+                return find<t_values>();
+            }
+            return &decoded.release()->values;
+        }
+    };
+
+    // payloads are ids of blobs in the blob_store of the facade that recorded them
     struct function_result
     {
-        std::string post_call_args;
-        std::string return_value;
+        t_blob_id post_call_args{0};
+        t_blob_id return_value{0};
         t_duration offest_from_origin;
         t_duration duration;
+        decoded_result_cache decoded;
     };
 
+    // Position of the next result of a call to replay. Threads replaying the same
+    // call concurrently take consecutive results, a copy of a call continues from
+    // where the original was
+    class result_cursor
+    {
+        std::atomic<size_t> m_next{0};
+
+    public:
+        result_cursor() = default;
+        result_cursor(const result_cursor& that) : m_next(that.m_next.load()) {}
+        result_cursor& operator=(const result_cursor& that)
+        {
+            m_next = that.m_next.load();
+            return *this;
+        }
+
+        size_t take() { return m_next.fetch_add(1, std::memory_order_relaxed); }
+    };
+
+    // Result cursors of the loaded calls of a recording for one facade replaying it.
+    // They are allocated in pages by the first replay of a call in a page, so a
+    // facade replaying a few calls of a large recording only pays for those
+    class replay_cursors
+    {
+        static constexpr size_t page_size = 64;
+        using t_page = std::array<result_cursor, page_size>;
+
+        size_t m_pages_num;
+        std::unique_ptr<std::atomic<t_page*>[]> m_pages;
+
+    public:
+        explicit replay_cursors(size_t cursors)
+            : m_pages_num((cursors + page_size - 1) / page_size),
+              m_pages(std::make_unique<std::atomic<t_page*>[]>(m_pages_num))
+        {
+        }
+
+        ~replay_cursors()
+        {
+            for (size_t idx = 0; idx < m_pages_num; ++idx) delete m_pages[idx].load();
+        }
+
+        result_cursor& operator[](size_t index)
+        {
+            auto& page = m_pages[index / page_size];
+            auto* cursors = page.load(std::memory_order_acquire);
+            if (!cursors) {
+                auto allocated = std::make_unique<t_page>();
+                if (page.compare_exchange_strong(
+                        cursors, allocated.get(), std::memory_order_acq_rel)) {
+                    cursors = allocated.release();
+                }
+            }
+            return (*cursors)[index % page_size];
+        }
+    };
+
+    struct recording_snapshot;
+
     struct function_call
     {
+        t_method_id function_id{0};
         std::string function_name;
-        std::string pre_call_args;
+        t_blob_id pre_call_args{0};
         std::vector<function_result> results;
-        mutable size_t current_result{0};
+        mutable result_cursor current_result;
 
-        const auto& get_next_result(const result_selection selection) const
+        // the cursor is kept apart from the call by every facade replaying it
+        const function_result& get_next_result(
+            const result_selection selection, result_cursor& cursor) const
         {
             if (results.empty()) throw std::logic_error{"results can't be empty"};
-            if (current_result >= results.size()) {
-                if (selection == result_selection::once) {
-                    throw std::logic_error{
-                        "method results are exceeded for " + function_name};
-                } else if (selection == result_selection::cycle) {
-                    current_result = 0;
-                }
+            const size_t next = cursor.take();
+            if (next >= results.size() && selection == result_selection::once) {
+                throw std::logic_error{
+                    "method results are exceeded for " + function_name};
             }
-            return results[current_result++];
+            return results[next % results.size()];
+        }
+
+        const function_result& get_next_result(const result_selection selection) const
+        {
+            return get_next_result(selection, current_result);
         }
 
         auto get_first_offset() const { return results.at(0).offest_from_origin; }
@@ -87,6 +246,9 @@ namespace facade
         passthrough = 0,
         recording,
         playing,
+        // replays the recorded calls, the calls missing in the recordings are made
+        // and merged into them
+        hybrid,
     };
 
     // The reason this interface is needed is to break circular dependency between the
@@ -97,11 +259,25 @@ namespace facade
         // These prefixes are added mainly to avoid method name clashing with
         // methods in the original class implementation
         virtual void facade_save(std::ostream& stream) = 0;
-        virtual void facade_load(std::istream& stream) = 0;
+        virtual void facade_load(std::shared_ptr<const utils::mapped_file> recording) = 0;
         virtual void facade_clear() = 0;
+        // appends the calls recorded since the previous flush to a streamed
+        // recording, returns the number of recorded bytes released from memory
+        virtual size_t facade_flush(std::ostream& stream) = 0;
         virtual const std::string& facade_name() const = 0;
         virtual const std::list<function_call>& get_callbacks() const = 0;
         virtual void invoke_callback(const function_call& callback) = 0;
+        virtual bool has_callback_invoker(t_method_id function_id) = 0;
+        // whether calls were recorded since the facade was cleared
+        virtual bool facade_has_new_calls() const = 0;
+        // nullptr reverts the method to the policy declared next to it
+        virtual void facade_set_recording_policy(
+            t_method_id function_id, const recording_policy* policy) = 0;
+        // the loaded recording, it isn't modified any more once it's shared
+        virtual std::shared_ptr<recording_snapshot> facade_share_snapshot() = 0;
+        // replays a recording loaded by another facade, false if it was loaded with
+        // another archive policy
+        virtual bool facade_replay_snapshot(std::shared_ptr<recording_snapshot>) = 0;
 
     public:
         friend class master;
@@ -144,6 +320,8 @@ namespace facade
             m_cv.notify_all();
         }
 
+        bool holds(const facade_interface* facade) const { return m_facade == facade; }
+
         operator bool() const { return m_facade != nullptr; }
         facade_interface* operator->() { return m_facade; }
         facade_interface& operator*() { return *m_facade; }
@@ -152,6 +330,7 @@ namespace facade
     class scheduled_callback_entry
     {
         const t_duration m_offset;
+        const t_method_id m_function_id;
         const function_call& m_call;
         std::shared_ptr<facade_proxy> m_facade_proxy;
 
@@ -164,6 +343,7 @@ namespace facade
         scheduled_callback_entry(
             const function_call& cbk, std::shared_ptr<facade_proxy> facade)
             : m_offset(cbk.get_first_offset()),
+              m_function_id(cbk.function_id),
               m_call(cbk),
               m_facade_proxy(std::move(facade))
         {
@@ -171,6 +351,7 @@ namespace facade
 
         scheduled_callback_entry(const scheduled_callback_entry& that)
             : m_offset(that.m_offset),
+              m_function_id(that.m_function_id),
               m_call(that.m_call),
               m_facade_proxy(that.m_facade_proxy)
         {
@@ -178,6 +359,27 @@ namespace facade
 
         auto offset() const { return m_offset; }
 
+        bool belongs_to(const facade_interface* facade) const
+        {
+            return m_facade_proxy->holds(facade);
+        }
+
+        bool is_same_callback(const scheduled_callback_entry& that) const
+        {
+            return m_facade_proxy == that.m_facade_proxy &&
+                m_function_id == that.m_function_id;
+        }
+
+        // a callback of a deleted facade counts as handled, invoke skips it
+        bool has_invoker() const
+        {
+            auto* facade = m_facade_proxy->ref();
+            if (!facade) return true;
+            const bool registered = facade->has_callback_invoker(m_function_id);
+            m_facade_proxy->unref();
+            return registered;
+        }
+
         void invoke() const
         {
             auto* facade = m_facade_proxy->ref();
@@ -192,128 +394,673 @@ namespace facade
         }
     };
 
+    // How late recorded callbacks were invoked compared to their recorded offsets,
+    // scaled by the replay time factor
+    struct callback_lateness_stats
+    {
+        uint64_t callbacks{0};
+        t_duration total{0};
+        t_duration max{0};
+
+        t_duration mean() const
+        {
+            return callbacks ? t_duration{total.count() / static_cast<int64_t>(callbacks)}
+                             : t_duration::zero();
+        }
+    };
+
+    // What the facades cost during the current or the last recording or replay
+    struct stats_snapshot
+    {
+        // methods called while the stats were collected, by facade and method name
+        std::vector<method_stats> methods;
+        utils::serializer_stats serialization;
+        callback_lateness_stats callback_lateness;
+        // callbacks waiting for their offset, for the client to register a
+        // handler and for a free worker
+        size_t scheduled_callbacks{0};
+        size_t waiting_callbacks{0};
+        size_t queued_callbacks{0};
+
+        const method_stats* find(
+            const std::string& facade_name, const std::string& method_name) const
+        {
+            for (const auto& method : methods) {
+                if (method.facade_name == facade_name &&
+                    method.method_name == method_name) {
+                    return &method;
+                }
+            }
+            return nullptr;
+        }
+
+        // a line per method and one for the callbacks and the serializer
+        std::string to_string() const
+        {
+            std::ostringstream ss;
+            for (const auto& method : methods) {
+                ss << method.facade_name << "." << method.method_name;
+                method_stats::visit(
+                    [&ss](const char* name, uint64_t value) {
+                        ss << " " << name << "=" << value;
+                    },
+                    method);
+                ss << " overhead_ns=" << method.overhead_ns() << "\n";
+            }
+            ss << "callbacks replayed=" << callback_lateness.callbacks
+               << " mean_lateness_us=" << callback_lateness.mean().count()
+               << " max_lateness_us=" << callback_lateness.max.count()
+               << " scheduled=" << scheduled_callbacks
+               << " waiting=" << waiting_callbacks << " queued=" << queued_callbacks
+               << "\nserializer enqueued=" << serialization.enqueued
+               << " dropped=" << serialization.dropped
+               << " blocked=" << serialization.blocked
+               << " max_queue_depth=" << serialization.max_queue_depth;
+            return ss.str();
+        }
+    };
+
     class master
     {
+        // a streamed recording is written to the same stream until it's finished,
+        // the file is owned by master unless the stream is provided by the client
+        struct recording_stream
+        {
+            std::unique_ptr<std::ofstream> file;
+            std::ostream* stream{nullptr};
+        };
+
+        struct streaming_settings
+        {
+            bool enabled{false};
+            size_t memory_budget{64 * 1024 * 1024};
+            t_duration flush_interval{1s};
+        };
+
+        // a thread adds the calls it makes while recording or playing to its own
+        // counter, the counters are on separate cache lines
+        struct alignas(64) active_calls_counter
+        {
+            std::atomic<int64_t> calls{0};
+        };
+        static constexpr size_t active_calls_counters = 16;
+
+        // Locks are taken in this order:
+        //   m_mtx          mode changes and configuration
+        //   m_registry_mtx registered facades and streamed recordings
+        //   m_scheduler_mtx callbacks waiting to be replayed
+        // Calls of facades take none of them unless a streamed recording runs out
+        // of its memory budget
         mutable std::mutex m_mtx;
+        mutable std::mutex m_registry_mtx;
+        mutable std::mutex m_scheduler_mtx;
+        // notified when the callbacks to replay change or the player stops
         mutable std::condition_variable m_cv;
         std::map<facade_interface*, std::shared_ptr<facade_proxy>> m_facades;
+        // recording policies set at runtime by facade name and method
+        std::map<std::pair<std::string, t_method_id>, recording_policy>
+            m_recording_policies;
         utils::worker_pool m_pool{1};
+        // loads and saves the recordings of the facades in parallel
+        size_t m_io_workers{default_io_workers()};
+        utils::worker_pool m_io_pool{m_io_workers};
+        utils::serializer m_serializer;
         std::filesystem::path m_recording_dir;
         std::string m_recording_file_extention;
         std::chrono::time_point<std::chrono::high_resolution_clock> m_origin;
         std::multiset<scheduled_callback_entry> m_callbacks;
+        // callbacks that became due before the client registered their handlers
+        std::multiset<scheduled_callback_entry> m_waiting_callbacks;
         std::thread m_player_thread;
+        bool m_player_running{false};
+        utils::thread_settings m_player_thread_settings{"facade-player"};
+        utils::thread_settings m_worker_thread_settings{"facade-worker"};
+        utils::thread_settings m_io_thread_settings{"facade-io"};
         t_log_message_cbk m_log_message_cbk;
         t_get_facade_stream_cbk m_get_facade_stream_cbk;
 
-        facade_mode m_mode{facade_mode::passthrough};
-        bool m_override_arguments{true};
+        // the mode in the lowest bits and the number of mode changes above them,
+        // published together so a call can tell the mode changed while it started
+        static constexpr uint64_t mode_bits = 2;
+        static constexpr uint64_t mode_mask = (1 << mode_bits) - 1;
+        std::atomic<uint64_t> m_mode_state{
+            static_cast<uint64_t>(facade_mode::passthrough)};
+        // the playing or hybrid mode the recordings are being loaded for, it's
+        // published once they are loaded. Passthrough while nothing is loaded
+        std::atomic<facade_mode> m_loading_mode{facade_mode::passthrough};
+        active_calls_counter m_active_calls[active_calls_counters];
+
+        std::atomic_bool m_override_arguments{true};
+        std::atomic_bool m_async_serialization{false};
+        std::atomic_bool m_compress_recordings{false};
+        std::atomic<size_t> m_compression_block_size{256 * 1024};
+        std::atomic<double> m_replay_time_factor{1.0};
+
+        // the configured settings are copied to the active ones by start_recording,
+        // so they don't change while calls are recorded
+        streaming_settings m_streaming;
+        streaming_settings m_active_streaming;
+        bool m_flushing{false};
+        std::atomic_bool m_flush_requested{false};
+        std::atomic<size_t> m_unflushed_bytes{0};
+        std::condition_variable m_flush_cv;
+        std::thread m_flusher_thread;
+        std::map<facade_interface*, recording_stream> m_recording_streams;
+
+        std::atomic<uint64_t> m_replayed_callbacks{0};
+        std::atomic<uint64_t> m_total_lateness_us{0};
+        std::atomic<uint64_t> m_max_lateness_us{0};
+
+        // counters of the methods by facade and method name, they live as long as
+        // master. The map is only locked by the first call of a method and by
+        // snapshots
+        std::map<std::pair<std::string, std::string>, std::unique_ptr<method_counters>>
+            m_method_counters;
+        mutable std::mutex m_stats_mtx;
+        std::atomic_bool m_collecting_stats{false};
+        std::atomic_bool m_dump_stats_on_stop{false};
+
+        // Recordings loaded for replay by path, the facades constructed later replay
+        // the same snapshot for as long as its file isn't modified. The lock is
+        // taken last
+        struct cached_snapshot
+        {
+            std::filesystem::file_time_type modified;
+            uintmax_t size{0};
+            std::shared_ptr<recording_snapshot> snapshot;
+        };
+        mutable std::map<std::string, cached_snapshot> m_snapshots;
+        mutable std::mutex m_snapshots_mtx;
+        // names the temporary files the saved recordings are written to
+        mutable std::atomic<size_t> m_replaced_recordings{0};
 
         using t_lock_guard = std::lock_guard<decltype(m_mtx)>;
         using t_unique_lock = std::unique_lock<decltype(m_mtx)>;
+        using t_facade_refs =
+            std::vector<std::pair<std::shared_ptr<facade_proxy>, facade_interface*>>;
+
+        static size_t default_io_workers()
+        {
+            return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+        }
+
+        static facade_mode mode_of(uint64_t state)
+        {
+            return static_cast<facade_mode>(state & mode_mask);
+        }
+
+        // only called under m_mtx
+        void publish_mode(facade_mode mode)
+        {
+            const uint64_t epoch = (m_mode_state.load() >> mode_bits) + 1;
+            m_mode_state.store((epoch << mode_bits) | static_cast<uint64_t>(mode));
+        }
+
+        static size_t this_thread_counter()
+        {
+            static std::atomic<size_t> threads{0};
+            thread_local const size_t counter = threads++ % active_calls_counters;
+            return counter;
+        }
+
+        // Waits for the calls that started before the mode was changed. A call
+        // that starts afterwards sees the new mode and doesn't stay counted, so
+        // the counters only go down
+        void wait_for_active_calls() const
+        {
+            for (const auto& counter : m_active_calls) {
+                while (counter.calls.load() != 0) std::this_thread::yield();
+            }
+        }
 
-        void initialize(facade_interface& facade) const
+        // The mode recordings are replayed in, the published one or the one they
+        // are being loaded for. The loading mode is cleared after the mode is
+        // published, so it's read first
+        facade_mode replay_mode() const
         {
-            if (is_playing()) { load_recording(facade); }
+            const auto loading = m_loading_mode.load();
+            return loading != facade_mode::passthrough ? loading : get_mode();
         }
 
-        void finalize(facade_interface& facade) const
+        static bool is_replaying(facade_mode mode)
         {
-            if (is_recording()) { save_recording(facade); }
+            return mode == facade_mode::playing || mode == facade_mode::hybrid;
+        }
+
+        // returns whether the recording of the facade was loaded
+        bool initialize(facade_interface& facade)
+        {
+            const auto mode = replay_mode();
+            if (!is_replaying(mode)) return false;
+            load_recording(facade, mode);
+            return true;
+        }
+
+        void finalize(facade_interface& facade)
+        {
+            if (is_hybrid()) {
+                save_merged_recording(facade);
+            } else if (is_recording()) {
+                // the calls of this facade that are still queued have to be in the
+                // recording, and no queued job may outlive the facade
+                m_serializer.drain();
+                if (is_streaming()) {
+                    t_lock_guard lg{m_registry_mtx};
+                    unprotected_finish_streamed_recording(facade);
+                } else {
+                    save_recording(facade);
+                }
+            }
             facade.facade_clear();
         }
 
-        void unprotected_register_callbacks(const std::shared_ptr<facade_proxy>& facade)
+        std::ostream* unprotected_open_recording_stream(facade_interface& facade)
+        {
+            const auto found = m_recording_streams.find(&facade);
+            if (found != m_recording_streams.end()) return found->second.stream;
+
+            recording_stream entry;
+            if (m_get_facade_stream_cbk) {
+                entry.stream = m_get_facade_stream_cbk(facade.facade_name());
+            } else {
+                // segments are appended to the file as they're flushed, so it can't
+                // be replaced like a saved recording, it's unlinked instead of being
+                // truncated and the mappings of the old one keep their contents
+                const auto path = make_recording_path(facade);
+                forget_snapshot(path);
+                std::error_code ec;
+                std::filesystem::remove(path, ec);
+                entry.file = std::make_unique<std::ofstream>(path, std::ios::binary);
+                entry.stream = entry.file.get();
+            }
+            if (entry.stream) recording_format::write_header(*entry.stream);
+            return m_recording_streams.emplace(&facade, std::move(entry))
+                .first->second.stream;
+        }
+
+        void unprotected_flush_recording(facade_interface& facade)
+        {
+            auto* stream = unprotected_open_recording_stream(facade);
+            if (!stream) return;
+            release_recording_memory(facade.facade_flush(*stream));
+        }
+
+        void unprotected_finish_streamed_recording(facade_interface& facade)
+        {
+            unprotected_flush_recording(facade);
+            m_recording_streams.erase(&facade);
+        }
+
+        void flusher_thread_main()
+        {
+            t_unique_lock ulck(m_registry_mtx);
+            while (m_flushing) {
+                m_flush_cv.wait_for(ulck, m_active_streaming.flush_interval,
+                    [this]() { return m_flush_requested || !m_flushing; });
+                if (!m_flushing) return;
+
+                m_flush_requested = false;
+                for (const auto& [_unused, facade_proxy_shptr] : m_facades) {
+                    if (!facade_proxy_shptr) continue;
+                    unprotected_flush_recording(**facade_proxy_shptr);
+                }
+                // wakes up recording threads waiting for memory to be released
+                m_flush_cv.notify_all();
+            }
+        }
+
+        void stop_flusher()
+        {
+            {
+                t_lock_guard lg{m_registry_mtx};
+                m_flushing = false;
+            }
+            m_flush_cv.notify_all();
+            if (m_flusher_thread.joinable()) m_flusher_thread.join();
+        }
+
+        // returns whether the facade has callbacks to replay
+        bool unprotected_register_callbacks(const std::shared_ptr<facade_proxy>& facade)
         {
             const auto& callbacks = (*facade)->get_callbacks();
             for (const auto& cbk : callbacks) {
                 scheduled_callback_entry entry{cbk, facade};
                 m_callbacks.insert(entry);
             }
+            return !callbacks.empty();
         }
 
-        void player_thread_main()
+        bool unprotected_erase_waiting_callbacks(const facade_interface* facade)
+        {
+            bool erased = false;
+            auto it = m_waiting_callbacks.begin();
+            while (it != m_waiting_callbacks.end()) {
+                if (it->belongs_to(facade)) {
+                    it = m_waiting_callbacks.erase(it);
+                    erased = true;
+                } else {
+                    ++it;
+                }
+            }
+            return erased;
+        }
+
+        bool unprotected_is_ready(const scheduled_callback_entry& entry) const
         {
-            t_duration origin = 0ms;
-            const t_duration delta = 1ms;
+            // a callback waits behind earlier calls of the same callback so they
+            // are replayed in the recorded order
+            for (const auto& waiting : m_waiting_callbacks) {
+                if (waiting.is_same_callback(entry)) return false;
+            }
+            return entry.has_invoker();
+        }
 
-            while (true) {
-                t_unique_lock ulck(m_mtx);
-                while (m_callbacks.empty() && m_mode == facade_mode::playing) {
+        void record_callback_lateness(const t_duration& lateness)
+        {
+            const auto lateness_us = static_cast<uint64_t>(
+                std::max(lateness, t_duration::zero()).count());
+            m_replayed_callbacks.fetch_add(1, std::memory_order_relaxed);
+            m_total_lateness_us.fetch_add(lateness_us, std::memory_order_relaxed);
+            auto max_lateness_us = m_max_lateness_us.load(std::memory_order_relaxed);
+            while (lateness_us > max_lateness_us &&
+                !m_max_lateness_us.compare_exchange_weak(max_lateness_us, lateness_us)) {
+            }
+        }
+
+        // Callbacks are dispatched at absolute deadlines computed from m_origin, so
+        // time spent dispatching doesn't accumulate. The thread waits on m_cv until
+        // the earliest deadline, a facade registering callbacks wakes it up early
+        void player_thread_main()
+        {
+            using t_clock = std::chrono::high_resolution_clock;
+            t_unique_lock ulck(m_scheduler_mtx);
+            while (m_player_running) {
+                if (m_callbacks.empty()) {
                     m_cv.wait(ulck);
+                    continue;
                 }
 
-                if (m_mode != facade_mode::playing) return;
-
                 const auto it = m_callbacks.begin();
+                const auto deadline = m_origin + scale_replay_time(it->offset());
+                const auto remaining = deadline - t_clock::now();
+                if (remaining > utils::spin_before_deadline) {
+                    m_cv.wait_until(ulck, deadline - utils::spin_before_deadline);
+                    continue;
+                }
+                if (remaining > t_duration::zero()) {
+                    // an earlier callback registered meanwhile is picked up right after
+                    ulck.unlock();
+                    utils::precise_sleep_until(deadline);
+                    ulck.lock();
+                    continue;
+                }
 
-                if (it->offset() <= origin) {
-                    auto callback_entry{*it};
-                    m_callbacks.erase(it);
-                    m_pool.submit([callback_entry]() { callback_entry.invoke(); });
-
+                auto callback_entry{*it};
+                m_callbacks.erase(it);
+                if (!unprotected_is_ready(callback_entry)) {
+                    // replayed as soon as the facade registers a handler for it
+                    m_waiting_callbacks.insert(callback_entry);
                     m_cv.notify_all();
                     continue;
                 }
+                // lateness includes the time the callback waits for a free worker,
+                // the task fits into the pool's task so dispatching doesn't allocate
+                m_pool.post([this, callback_entry, deadline]() {
+                    record_callback_lateness(std::chrono::duration_cast<t_duration>(
+                        t_clock::now() - deadline));
+                    callback_entry.invoke();
+                });
+                m_cv.notify_all();
+            }
+        }
 
-                std::this_thread::sleep_for(delta);
-                origin += delta;
+        // the recording is compressed as a whole after it's saved to memory, so
+        // facades don't know whether their recordings are compressed
+        void save_recording(facade_interface& facade, std::ostream& stream) const
+        {
+            if (!m_compress_recordings) {
+                facade.facade_save(stream);
+                return;
+            }
+            std::ostringstream saved;
+            facade.facade_save(saved);
+            recording_format::write_compressed(
+                stream, saved.str(), m_compression_block_size);
+        }
+
+        // A recording file may still be mapped for replay by the facades sharing
+        // its snapshot or by other processes, and truncating it would fault their
+        // reads. write(stream) writes the recording to a temporary file next to it
+        // that replaces it, the mappings keep the contents they were made of.
+        // Recordings are also saved by destructors of facades, so a file that
+        // can't be replaced is logged
+        template <typename t_write>
+        void replace_recording(
+            const std::filesystem::path& path, const t_write& write) const
+        {
+            auto temporary = path;
+            temporary += ".tmp" + std::to_string(m_replaced_recordings++);
+            std::error_code ec;
+            try {
+                std::ofstream ofs(temporary, std::ios::binary);
+                write(ofs);
+            } catch (...) {
+                std::filesystem::remove(temporary, ec);
+                throw;
             }
+            forget_snapshot(path);
+            std::filesystem::rename(temporary, path, ec);
+            if (!ec) return;
+            log_message(log_message_level::error,
+                "failed to replace a recording: " + path.string() + ": " + ec.message());
+            std::filesystem::remove(temporary, ec);
         }
 
         void save_recording(facade_interface& facade) const
         {
             if (m_get_facade_stream_cbk) {
                 auto* stream = m_get_facade_stream_cbk(facade.facade_name());
-                if (stream) facade.facade_save(*stream);
+                if (stream) save_recording(facade, *stream);
             } else {
-                const auto path = make_recording_path(facade);
-                std::ofstream ofs(path);
-                facade.facade_save(ofs);
+                replace_recording(make_recording_path(facade),
+                    [this, &facade](std::ostream& stream) {
+                        save_recording(facade, stream);
+                    });
             }
         }
 
-        void load_recording(facade_interface& facade) const
+        // The recording the facade replays is merged into the saved one, so it's
+        // saved to memory before the facade is cleared
+        void save_merged_recording(facade_interface& facade)
         {
-            const auto path = make_recording_path(facade);
+            if (!facade.facade_has_new_calls()) return;
+            if (m_get_facade_stream_cbk) {
+                save_recording(facade);
+                return;
+            }
+            std::ostringstream merged;
+            save_recording(facade, merged);
+            facade.facade_clear();
+            replace_recording(make_recording_path(facade),
+                [&merged](std::ostream& stream) { stream << merged.str(); });
+        }
 
+        // false if the file doesn't exist or can't be read
+        static bool stamp_recording(
+            const std::filesystem::path& path, cached_snapshot& stamp)
+        {
             std::error_code ec;
-            if (!std::filesystem::exists(path, ec)) {
+            stamp.modified = std::filesystem::last_write_time(path, ec);
+            if (ec) return false;
+            stamp.size = std::filesystem::file_size(path, ec);
+            return !ec;
+        }
+
+        // an entry of a modified file is dropped
+        std::shared_ptr<recording_snapshot> find_snapshot(
+            const std::filesystem::path& path, const cached_snapshot& stamp) const
+        {
+            std::lock_guard<std::mutex> lg{m_snapshots_mtx};
+            const auto found = m_snapshots.find(path.string());
+            if (found == m_snapshots.end()) return nullptr;
+            const auto& cached = found->second;
+            if (cached.modified == stamp.modified && cached.size == stamp.size) {
+                return cached.snapshot;
+            }
+            m_snapshots.erase(found);
+            return nullptr;
+        }
+
+        void cache_snapshot(const std::filesystem::path& path, cached_snapshot&& stamp,
+            std::shared_ptr<recording_snapshot> snapshot) const
+        {
+            stamp.snapshot = std::move(snapshot);
+            std::lock_guard<std::mutex> lg{m_snapshots_mtx};
+            m_snapshots[path.string()] = std::move(stamp);
+        }
+
+        // called before a recording file is written, the cached snapshot may map it
+        void forget_snapshot(const std::filesystem::path& path) const
+        {
+            std::lock_guard<std::mutex> lg{m_snapshots_mtx};
+            m_snapshots.erase(path.string());
+        }
+
+        // Decompresses the blocks of a recording on the I/O workers. This thread
+        // takes blocks as well and only waits for the blocks the workers took, so
+        // it doesn't depend on an idle worker when it runs on one itself
+        std::string decompress_on_io_workers(
+            std::shared_ptr<const utils::mapped_file> file)
+        {
+            struct decompression
+            {
+                std::shared_ptr<const utils::mapped_file> file;
+                recording_format::compressed_view view;
+                std::string recording;
+                std::atomic<size_t> next_block{0};
+                std::mutex mtx;
+                std::condition_variable cv;
+                size_t done{0};
+                std::exception_ptr error;
+
+                explicit decompression(std::shared_ptr<const utils::mapped_file> mapped)
+                    : file(std::move(mapped))
+                    , view(file->data(), file->size())
+                    , recording(view.raw_size(), '\0')
+                {
+                }
+
+                void run()
+                {
+                    for (size_t idx = next_block++; idx < view.blocks();
+                         idx = next_block++) {
+                        std::exception_ptr block_error;
+                        try {
+                            view.decompress_block(idx, recording.data());
+                        } catch (...) {
+                            block_error = std::current_exception();
+                        }
+                        std::lock_guard<std::mutex> lg{mtx};
+                        if (block_error && !error) error = block_error;
+                        if (++done == view.blocks()) cv.notify_all();
+                    }
+                }
+            };
+
+            const auto state = std::make_shared<decompression>(std::move(file));
+            const size_t blocks = state->view.blocks();
+            const size_t threads = std::min(blocks, m_io_workers);
+            if (threads > 1) m_io_pool.start();
+            // helpers that start after all the blocks were taken return right away,
+            // they may do so after this returns
+            for (size_t idx = 1; idx < threads; ++idx) {
+                m_io_pool.post([state]() { state->run(); });
+            }
+            state->run();
+            std::unique_lock<std::mutex> ulck{state->mtx};
+            state->cv.wait(ulck, [&state, blocks]() { return state->done == blocks; });
+            if (state->error) std::rethrow_exception(state->error);
+            return std::move(state->recording);
+        }
+
+        // A recording loaded by start_playing is decompressed on the I/O workers,
+        // the pool is left alone while facades are constructed concurrently
+        void load_recording(
+            facade_interface& facade, facade_mode mode, bool on_io_workers = false)
+        {
+            const auto path = make_recording_path(facade);
+
+            cached_snapshot stamp;
+            if (!stamp_recording(path, stamp)) {
+                // a facade without a recording records all its calls in hybrid mode
+                if (mode == facade_mode::hybrid) return;
                 throw std::runtime_error{
                     std::string{"a recording file doesn't exist: "} + path.string()};
             }
 
-            std::ifstream ifs{path};
-            if (!ifs.is_open()) {
-                throw std::runtime_error{
-                    std::string{"failed to load a recording: "} + path.string()};
+            // facades replaying an unmodified file share the snapshot the first one
+            // loaded, constructing the others doesn't read the file. Facades merge
+            // new calls into their snapshots in hybrid mode, so they load their own
+            const bool shared = mode != facade_mode::hybrid;
+            if (shared) {
+                auto snapshot = find_snapshot(path, stamp);
+                if (snapshot && facade.facade_replay_snapshot(std::move(snapshot))) {
+                    return;
+                }
             }
 
-            facade.facade_load(ifs);
+            // the facade keeps the mapping alive for as long as it needs to decode
+            // calls from it
+            auto recording = std::make_shared<const utils::mapped_file>(path.string());
+            if (recording_format::is_compressed(recording->data(), recording->size())) {
+                std::string decompressed;
+                if (on_io_workers) {
+                    decompressed = decompress_on_io_workers(recording);
+                } else {
+                    const recording_format::compressed_view compressed{
+                        recording->data(), recording->size()};
+                    decompressed = compressed.decompress();
+                }
+                recording = std::make_shared<const utils::mapped_file>(
+                    utils::mapped_file::in_memory{}, std::move(decompressed));
+            }
+            facade.facade_load(std::move(recording));
+            if (shared) {
+                cache_snapshot(path, std::move(stamp), facade.facade_share_snapshot());
+            }
         }
 
     protected:
         void register_facade(facade_interface* facade)
         {
-            initialize(*facade);
+            const bool loaded = initialize(*facade);
             {
-                t_lock_guard lg{m_mtx};
+                t_lock_guard lg{m_registry_mtx};
+                // playing started after the facade was initialized and the facades
+                // whose recordings are loaded were taken before it was registered
+                if (!loaded) initialize(*facade);
                 auto&& [it, inserted] =
                     m_facades.insert({facade, std::make_shared<facade_proxy>(facade)});
-                unprotected_register_callbacks(it->second);
-                m_cv.notify_all();
+                for (const auto& [method, policy] : m_recording_policies) {
+                    if (method.first != facade->facade_name()) continue;
+                    facade->facade_set_recording_policy(method.second, &policy);
+                }
+                // constructing facades without callbacks doesn't wake up the player
+                t_lock_guard scheduler_lg{m_scheduler_mtx};
+                if (unprotected_register_callbacks(it->second)) m_cv.notify_all();
             }
         }
         void unregister_facade(facade_interface* facade)
         {
             std::shared_ptr<facade_proxy> proxy_shptr;
             {
-                t_lock_guard lg{m_mtx};
+                t_lock_guard lg{m_registry_mtx};
                 const auto found = m_facades.find(facade);
                 if (found == m_facades.end()) return;
                 proxy_shptr = std::move(found->second);
                 m_facades.erase(found);
-                m_cv.notify_all();
+                t_lock_guard scheduler_lg{m_scheduler_mtx};
+                if (unprotected_erase_waiting_callbacks(facade)) m_cv.notify_all();
             }
             // this will ensure that facade is not replaying any recoded callbacks
             // and it's safe to delete it now
@@ -321,52 +1068,568 @@ namespace facade
             finalize(*facade);
         }
 
-        master() {}
+        master()
+        {
+            m_pool.set_thread_settings(m_worker_thread_settings);
+            m_io_pool.set_thread_settings(m_io_thread_settings);
+        }
+
+        utils::thread_settings with_error_reporting(utils::thread_settings settings) const
+        {
+            if (!settings.report_error) {
+                settings.report_error = [this](const std::string& msg) {
+                    log_message(log_message_level::warning, msg);
+                };
+            }
+            return settings;
+        }
+
+        void stop_player()
+        {
+            {
+                t_lock_guard lg{m_scheduler_mtx};
+                m_player_running = false;
+                m_cv.notify_all();
+            }
+            if (m_player_thread.joinable()) m_player_thread.join();
+            // callbacks already handed over to the workers are completed
+            m_pool.stop();
+        }
 
-        void unprotected_save_recordings()
+        void unprotected_stop()
+        {
+            if (is_passing_through()) return;
+            stop_player();
+            stop_flusher();
+            const bool recording = is_recording();
+            const bool hybrid = is_hybrid();
+            publish_mode(facade_mode::passthrough);
+            wait_for_active_calls();
+            if (hybrid) save_recordings(true);
+            if (recording) {
+                stop_serializer();
+                if (m_active_streaming.enabled) {
+                    t_lock_guard lg{m_registry_mtx};
+                    unprotected_finish_streamed_recordings();
+                    m_active_streaming.enabled = false;
+                } else {
+                    save_recordings(false);
+                }
+            }
+            if (m_collecting_stats && m_dump_stats_on_stop) {
+                log_message(log_message_level::info, get_stats().to_string());
+            }
+        }
+
+        void reset_method_counters()
+        {
+            t_lock_guard lg{m_stats_mtx};
+            for (auto& [_unused, counters] : m_method_counters) {
+                method_counters::visit([](const char*, auto& counter) { counter = 0; },
+                    *counters);
+            }
+        }
+
+        void stop_serializer()
+        {
+            if (!m_serializer.is_running()) return;
+            m_serializer.stop();
+            const auto stats = m_serializer.stats();
+            if (stats.dropped) {
+                log_message(log_message_level::warning,
+                    std::to_string(stats.dropped) +
+                        " calls were dropped by the serializer and are missing in the "
+                        "recording");
+            }
+        }
+
+        void unprotected_finish_streamed_recordings()
         {
             for (const auto& [_unused, facade_proxy_shptr] : m_facades) {
                 if (!facade_proxy_shptr) continue;
                 auto& facade = **facade_proxy_shptr;
-                save_recording(facade);
+                unprotected_finish_streamed_recording(facade);
                 facade.facade_clear();
             }
+            m_recording_streams.clear();
         }
 
-        void unprotected_load_recordings()
+        // A referenced facade isn't destroyed until it's released, its destructor
+        // waits for it without holding any lock of master
+        t_facade_refs unprotected_reference_facades() const
         {
-            m_callbacks.clear();
+            t_facade_refs facades;
             for (const auto& [_unused, facade_proxy_shptr] : m_facades) {
                 if (!facade_proxy_shptr) continue;
-                auto& facade = **facade_proxy_shptr;
-                const auto path = make_recording_path(facade);
-                facade.facade_clear();
-                load_recording(facade);
-                unprotected_register_callbacks(facade_proxy_shptr);
+                if (auto* facade = facade_proxy_shptr->ref()) {
+                    facades.emplace_back(facade_proxy_shptr, facade);
+                }
             }
+            return facades;
+        }
+
+        static void release_facades(t_facade_refs& facades)
+        {
+            for (auto& [facade_proxy_shptr, _unused] : facades) {
+                facade_proxy_shptr->unref();
+            }
+            facades.clear();
+        }
+
+        // Runs task(item) for every item, i.e. a referenced facade, on the I/O
+        // workers, or on this thread unless parallel. Returns the first exception
+        // thrown by a task once all of them are done
+        template <typename t_items, typename t_task>
+        std::exception_ptr run_on_io_workers(
+            const t_items& items, bool parallel, const t_task& task)
+        {
+            std::exception_ptr error;
+            if (!parallel || items.size() < 2 || m_io_workers < 2) {
+                for (const auto& item : items) {
+                    try {
+                        task(item);
+                    } catch (...) {
+                        if (!error) error = std::current_exception();
+                    }
+                }
+                return error;
+            }
+
+            m_io_pool.start();
+            std::vector<std::future<void>> done;
+            done.reserve(items.size());
+            for (const auto& item : items) {
+                done.push_back(m_io_pool.submit([&task, &item]() { task(item); }));
+            }
+            for (auto& future : done) {
+                try {
+                    future.get();
+                } catch (...) {
+                    if (!error) error = std::current_exception();
+                }
+            }
+            return error;
+        }
+
+        // Saves the recordings of the registered facades in parallel, a facade
+        // destroyed meanwhile waits for its recording to be saved. Facades of the
+        // same name share a file, they are saved one after another by one worker
+        // and the last one saved wins. The client's stream callback may not be
+        // thread safe, the recordings are saved one by one when there is one
+        void save_recordings(bool merged)
+        {
+            t_facade_refs facades;
+            {
+                t_lock_guard lg{m_registry_mtx};
+                facades = unprotected_reference_facades();
+            }
+            std::map<std::filesystem::path, std::vector<facade_interface*>> by_path;
+            for (const auto& [_unused, facade] : facades) {
+                by_path[make_recording_path(*facade)].push_back(facade);
+            }
+            const auto error = run_on_io_workers(by_path, !m_get_facade_stream_cbk,
+                [this, merged](const auto& path_facades) {
+                    std::exception_ptr error;
+                    for (auto* facade : path_facades.second) {
+                        try {
+                            if (merged) {
+                                save_merged_recording(*facade);
+                            } else {
+                                save_recording(*facade);
+                            }
+                            facade->facade_clear();
+                        } catch (...) {
+                            if (!error) error = std::current_exception();
+                        }
+                    }
+                    if (error) std::rethrow_exception(error);
+                });
+            release_facades(facades);
+            if (error) std::rethrow_exception(error);
+        }
+
+        // The recordings of the registered facades are loaded in parallel, master's
+        // locks are only held to take the facades and to schedule their callbacks.
+        // A facade registered meanwhile loads its recording by itself
+        void load_recordings(facade_mode mode)
+        {
+            t_facade_refs facades;
+            {
+                t_lock_guard registry_lg{m_registry_mtx};
+                t_lock_guard scheduler_lg{m_scheduler_mtx};
+                m_callbacks.clear();
+                m_waiting_callbacks.clear();
+                facades = unprotected_reference_facades();
+                m_loading_mode = mode;
+            }
+            const auto error =
+                run_on_io_workers(facades, true, [this, mode](const auto& entry) {
+                    entry.second->facade_clear();
+                    load_recording(*entry.second, mode, true);
+                });
+            if (!error) {
+                t_lock_guard registry_lg{m_registry_mtx};
+                t_lock_guard scheduler_lg{m_scheduler_mtx};
+                for (const auto& [facade_proxy_shptr, facade] : facades) {
+                    // a facade being destroyed meanwhile is no longer registered
+                    const auto found = m_facades.find(facade);
+                    if (found == m_facades.end() || found->second != facade_proxy_shptr) {
+                        continue;
+                    }
+                    unprotected_register_callbacks(facade_proxy_shptr);
+                }
+                m_player_running = true;
+            }
+            release_facades(facades);
+            if (error) std::rethrow_exception(error);
+        }
+
+        void unprotected_start_playing(facade_mode mode)
+        {
+            unprotected_stop();
+
+            reset_method_counters();
+            m_replayed_callbacks = 0;
+            m_total_lateness_us = 0;
+            m_max_lateness_us = 0;
+            // published once the recordings are loaded, the calls replay them
+            // without a lock
+            try {
+                load_recordings(mode);
+            } catch (...) {
+                m_loading_mode = facade_mode::passthrough;
+                throw;
+            }
+            m_origin = std::chrono::high_resolution_clock::now();
+            publish_mode(mode);
+            m_loading_mode = facade_mode::passthrough;
+            m_pool.start();
+            m_player_thread = utils::make_thread(
+                m_player_thread_settings, [this]() { player_thread_main(); });
         }
 
     public:
         friend class facade_base;
 
-        bool is_passing_through() const { return m_mode == facade_mode::passthrough; }
-        bool is_playing() const { return m_mode == facade_mode::playing; }
-        bool is_recording() const { return m_mode == facade_mode::recording; }
+        // A facade call made while recording or playing is counted for as long as
+        // it runs, a mode change waits for the calls that started in the previous
+        // mode before saving or releasing what they use. The call follows the mode
+        // it has seen when it started even if the mode changes meanwhile
+        class call_scope
+        {
+            master& m_master;
+            facade_mode m_mode;
+            active_calls_counter* m_counter{nullptr};
+
+        public:
+            explicit call_scope(master& owner) : m_master(owner)
+            {
+                while (true) {
+                    const uint64_t state = m_master.m_mode_state.load();
+                    m_mode = mode_of(state);
+                    // passing through uses nothing a mode change could release
+                    if (m_mode == facade_mode::passthrough) return;
+                    auto& counter = m_master.m_active_calls[this_thread_counter()];
+                    counter.calls.fetch_add(1);
+                    // either the mode change is seen here or this call is seen by
+                    // the thread that changed the mode
+                    if (m_master.m_mode_state.load() == state) {
+                        m_counter = &counter;
+                        return;
+                    }
+                    counter.calls.fetch_sub(1);
+                }
+            }
 
-        bool is_overriding_arguments() const { return m_override_arguments; }
+            call_scope(const call_scope&) = delete;
+            call_scope& operator=(const call_scope&) = delete;
+
+            ~call_scope()
+            {
+                if (m_counter) m_counter->calls.fetch_sub(1);
+            }
+
+            facade_mode mode() const { return m_mode; }
+        };
+
+        call_scope enter_call() { return call_scope{*this}; }
+
+        facade_mode get_mode() const
+        {
+            return mode_of(m_mode_state.load(std::memory_order_acquire));
+        }
+
+        bool is_passing_through() const { return get_mode() == facade_mode::passthrough; }
+        // true in hybrid mode too
+        bool is_playing() const
+        {
+            const auto mode = get_mode();
+            return mode == facade_mode::playing || mode == facade_mode::hybrid;
+        }
+        bool is_hybrid() const { return get_mode() == facade_mode::hybrid; }
+        bool is_recording() const { return get_mode() == facade_mode::recording; }
+
+        bool is_overriding_arguments() const
+        {
+            return m_override_arguments.load(std::memory_order_relaxed);
+        }
         void override_arguments(const bool enabled) { m_override_arguments = enabled; }
 
+        // Recorded durations of methods and offsets of callbacks are multiplied by
+        // the factor on replay: 0 replays without any delays, 0.1 ten times faster
+        // than recorded, 1 in real time and 4 four times slower. Negative, infinite
+        // and NaN factors are rejected
+        master& set_replay_time_factor(double factor)
+        {
+            if (!std::isfinite(factor) || factor < 0) {
+                throw std::invalid_argument{"replay time factor must be finite and >= 0"};
+            }
+            m_replay_time_factor = factor;
+            return *this;
+        }
+
+        double get_replay_time_factor() const { return m_replay_time_factor; }
+
+        t_duration scale_replay_time(const t_duration& recorded) const
+        {
+            const double factor = m_replay_time_factor.load(std::memory_order_relaxed);
+            if (factor == 1.0) return recorded;
+            return std::chrono::duration_cast<t_duration>(
+                std::chrono::duration<double, t_duration::period>{recorded} * factor);
+        }
+
+        // Called by a facade when the client registers a callback handler, the
+        // callbacks of the facade that became due before are replayed right away
+        void callback_invoker_registered(const facade_interface* facade)
+        {
+            t_lock_guard lg{m_scheduler_mtx};
+            if (m_waiting_callbacks.empty()) return;
+            auto it = m_waiting_callbacks.begin();
+            while (it != m_waiting_callbacks.end()) {
+                if (!it->belongs_to(facade)) {
+                    ++it;
+                    continue;
+                }
+                m_callbacks.insert(*it);
+                it = m_waiting_callbacks.erase(it);
+            }
+            m_cv.notify_all();
+        }
+
+        // statistics of the current or the last replay
+        callback_lateness_stats get_callback_lateness() const
+        {
+            callback_lateness_stats stats;
+            stats.callbacks = m_replayed_callbacks;
+            stats.total = t_duration{static_cast<int64_t>(m_total_lateness_us.load())};
+            stats.max = t_duration{static_cast<int64_t>(m_max_lateness_us.load())};
+            return stats;
+        }
+
+        // When enabled, facade calls made while recording or playing count what
+        // they do and how long it takes, per facade name and method. It costs a few
+        // clock reads and atomic additions per call. The counters start from zero
+        // with every recording or replay, dump_on_stop logs them as info when it's
+        // stopped
+        master& set_stats_collection(bool enabled, bool dump_on_stop = false)
+        {
+            m_collecting_stats = enabled;
+            m_dump_stats_on_stop = dump_on_stop;
+            return *this;
+        }
+
+        bool is_collecting_stats() const
+        {
+            return m_collecting_stats.load(std::memory_order_relaxed);
+        }
+
+        // the counters of a method, a facade looks them up once per method
+        method_counters& get_method_counters(
+            const std::string& facade_name, const char* method_name)
+        {
+            t_lock_guard lg{m_stats_mtx};
+            auto& counters = m_method_counters[{facade_name, method_name}];
+            if (!counters) counters = std::make_unique<method_counters>();
+            return *counters;
+        }
+
+        stats_snapshot get_stats() const
+        {
+            stats_snapshot snapshot;
+            {
+                t_lock_guard lg{m_stats_mtx};
+                for (const auto& [name, counters] : m_method_counters) {
+                    method_stats stats;
+                    method_stats::visit(
+                        [](const char*, uint64_t& value, const auto& counter) {
+                            value = counter.load(std::memory_order_relaxed);
+                        },
+                        stats, *counters);
+                    if (stats.calls == 0) continue;
+                    stats.facade_name = name.first;
+                    stats.method_name = name.second;
+                    snapshot.methods.push_back(std::move(stats));
+                }
+            }
+            snapshot.serialization = get_serialization_stats();
+            snapshot.callback_lateness = get_callback_lateness();
+            {
+                t_lock_guard lg{m_scheduler_mtx};
+                snapshot.scheduled_callbacks = m_callbacks.size();
+                snapshot.waiting_callbacks = m_waiting_callbacks.size();
+            }
+            snapshot.queued_callbacks = m_pool.queued();
+            return snapshot;
+        }
+
+        // blocks for as long as a recorded call took, scaled by the replay factor
+        void replay_duration(const t_duration& recorded) const
+        {
+            utils::precise_sleep_for(scale_replay_time(recorded));
+        }
+
+        // When enabled, recording threads only copy arguments and return values of
+        // a call, they are serialized and hashed on a background thread. Calls with
+        // arguments that can't be copied are still serialized on the calling thread.
+        // Takes effect on the next start_recording
+        master& set_async_serialization(bool enabled, size_t queue_capacity = 65536,
+            utils::overflow_policy policy = utils::overflow_policy::block)
+        {
+            t_lock_guard lg{m_mtx};
+            m_async_serialization = enabled;
+            m_serializer.configure(queue_capacity, policy);
+            return *this;
+        }
+
+        bool is_serializing_async() const
+        {
+            return m_async_serialization && is_recording();
+        }
+
+        // returns false if the call is dropped because the queue is full
+        bool serialize_async(utils::serializer::t_job job)
+        {
+            return m_serializer.submit(std::move(job));
+        }
+
+        // counters of the current or the last recording
+        utils::serializer_stats get_serialization_stats() const
+        {
+            return m_serializer.stats();
+        }
+
+        // Saved recordings are compressed in independent blocks of the given raw
+        // size, compressed recordings are recognized and decompressed when they are
+        // loaded whether the option is enabled or not. Streamed recordings are
+        // written as they are
+        master& set_recording_compression(bool enabled, size_t block_size = 256 * 1024)
+        {
+            if (block_size == 0) throw std::invalid_argument{"block size can't be 0"};
+            m_compress_recordings = enabled;
+            m_compression_block_size = block_size;
+            return *this;
+        }
+
+        bool is_compressing_recordings() const { return m_compress_recordings; }
+
+        // Sets how the calls of a method are recorded, overriding the policy declared
+        // with FACADE_RECORDING_POLICY. It applies to the facades with the given name
+        // that exist now and that are created later, a new policy starts sampling
+        // and counting results anew
+        master& set_recording_policy(const std::string& facade_name,
+            const std::string& method_name, const recording_policy& policy)
+        {
+            policy.validate();
+            const auto function_id = method_id(method_name);
+            t_lock_guard lg{m_registry_mtx};
+            m_recording_policies[{facade_name, function_id}] = policy;
+            for (const auto& [_unused, facade_proxy_shptr] : m_facades) {
+                if (!facade_proxy_shptr) continue;
+                auto& facade = **facade_proxy_shptr;
+                if (facade.facade_name() != facade_name) continue;
+                facade.facade_set_recording_policy(function_id, &policy);
+            }
+            return *this;
+        }
+
+        // the method is recorded by the policy it declares again, or entirely
+        master& reset_recording_policy(
+            const std::string& facade_name, const std::string& method_name)
+        {
+            const auto function_id = method_id(method_name);
+            t_lock_guard lg{m_registry_mtx};
+            m_recording_policies.erase({facade_name, function_id});
+            for (const auto& [_unused, facade_proxy_shptr] : m_facades) {
+                if (!facade_proxy_shptr) continue;
+                auto& facade = **facade_proxy_shptr;
+                if (facade.facade_name() != facade_name) continue;
+                facade.facade_set_recording_policy(function_id, nullptr);
+            }
+            return *this;
+        }
+
+        // When enabled, recorded calls are periodically appended to the recording
+        // files as segments instead of being kept in memory until the recording is
+        // saved. A flush is requested as soon as the recorded data held in memory
+        // exceeds the budget, and recording threads wait for it once the data
+        // exceeds twice the budget. Takes effect on the next start_recording
+        master& set_streaming_recording(bool enabled,
+            size_t memory_budget = 64 * 1024 * 1024, t_duration flush_interval = 1s)
+        {
+            t_lock_guard lg{m_mtx};
+            m_streaming = {enabled, memory_budget, flush_interval};
+            return *this;
+        }
+
+        bool is_streaming() const { return is_recording() && m_active_streaming.enabled; }
+
+        // accounts for recorded data held in memory by a facade until it's flushed
+        void reserve_recording_memory(size_t bytes)
+        {
+            const size_t budget = m_active_streaming.memory_budget;
+            if (m_unflushed_bytes >= 2 * budget) {
+                // the flusher falls behind, wait for it rather than grow past the
+                // budget. The bytes of this call are not accounted yet, otherwise
+                // the wait could never end since they can't be flushed before
+                t_unique_lock ulck(m_registry_mtx);
+                while (m_unflushed_bytes >= budget && m_flushing) {
+                    m_flush_requested = true;
+                    m_flush_cv.notify_all();
+                    m_flush_cv.wait(ulck);
+                }
+            }
+
+            const auto unflushed = m_unflushed_bytes.fetch_add(bytes) + bytes;
+            if (unflushed >= budget && !m_flush_requested.exchange(true)) {
+                m_flush_cv.notify_all();
+            }
+        }
+
+        // the recorded data was flushed or dropped
+        void release_recording_memory(size_t bytes) { m_unflushed_bytes -= bytes; }
+
+        size_t get_unflushed_bytes() const { return m_unflushed_bytes; }
+
         std::filesystem::path make_recording_path(const facade_interface& facade) const
         {
             return std::filesystem::path{m_recording_dir} /
                 (facade.facade_name() + m_recording_file_extention);
         }
 
+        // Loaded recordings are cached until their files are modified, this releases
+        // the ones no facade replays any more
+        void clear_recording_snapshots()
+        {
+            std::lock_guard<std::mutex> lg{m_snapshots_mtx};
+            m_snapshots.clear();
+        }
+
+        // the instance is created on first use, which is thread safe, and at the
+        // latest during the static initialization, see eager_master_instance
         static master& get_instance()
         {
-            static std::unique_ptr<master> m_instance;
-            if (!m_instance) { m_instance = std::unique_ptr<master>(new master); }
-            return *m_instance;
+            static master instance;
+            return instance;
         }
 
         master& set_recording_directory(
@@ -389,53 +1652,110 @@ namespace facade
             t_lock_guard lg{m_mtx};
             if (!is_passing_through()) return;
             m_pool = utils::worker_pool{workers};
+            m_pool.set_thread_settings(m_worker_thread_settings);
         }
 
-        void start_recording()
+        // Workers loading and saving the recordings of the facades in parallel when
+        // playing starts and recording stops, one per hardware thread by default
+        void set_number_of_io_workers(size_t workers)
         {
-            stop();
+            t_lock_guard lg{m_mtx};
+            m_io_workers = std::max<size_t>(workers, 1);
+            m_io_pool = utils::worker_pool{m_io_workers};
+            m_io_pool.set_thread_settings(m_io_thread_settings);
+        }
 
+        size_t get_number_of_io_workers()
+        {
             t_lock_guard lg{m_mtx};
-            m_mode = facade_mode::recording;
+            return m_io_workers;
+        }
+
+        // Placement of the thread replaying callbacks: name, CPU affinity and
+        // priority. Pinning it and the workers keeps the replay timing from being
+        // disturbed by migrations and other load. Takes effect on the next
+        // start_playing, settings that can't be applied are logged as warnings
+        // unless the settings have their own error callback
+        master& set_player_thread_settings(utils::thread_settings settings)
+        {
+            t_lock_guard lg{m_mtx};
+            m_player_thread_settings = with_error_reporting(std::move(settings));
+            return *this;
+        }
+
+        // Placement of the workers invoking replayed callbacks, see
+        // set_player_thread_settings. The workers get their index appended to the
+        // name and can be pinned to a CPU each
+        master& set_worker_thread_settings(utils::thread_settings settings)
+        {
+            t_lock_guard lg{m_mtx};
+            m_worker_thread_settings = with_error_reporting(std::move(settings));
+            m_pool.set_thread_settings(m_worker_thread_settings);
+            return *this;
+        }
+
+        // Placement of the workers loading and saving recordings, see
+        // set_player_thread_settings. Takes effect the next time they are started
+        master& set_io_thread_settings(utils::thread_settings settings)
+        {
+            t_lock_guard lg{m_mtx};
+            m_io_thread_settings = with_error_reporting(std::move(settings));
+            m_io_pool.set_thread_settings(m_io_thread_settings);
+            return *this;
+        }
+
+        void start_recording()
+        {
+            t_lock_guard lg{m_mtx};
+            unprotected_stop();
+
+            // everything a recorded call uses is set up before the mode is published
+            reset_method_counters();
             m_origin = std::chrono::high_resolution_clock::now();
+            if (m_async_serialization) m_serializer.start();
+            m_unflushed_bytes = 0;
+            m_active_streaming = m_streaming;
+            if (m_active_streaming.enabled) {
+                m_flushing = true;
+                m_flusher_thread = std::thread{[this]() { flusher_thread_main(); }};
+            }
+            publish_mode(facade_mode::recording);
         }
 
         void start_playing()
         {
-            stop();
+            t_lock_guard lg{m_mtx};
+            unprotected_start_playing(facade_mode::playing);
+        }
 
+        // Replays like start_playing, but a call that isn't in the recording is made
+        // by the implementation of the facade, if it has one, and recorded. stop
+        // saves the recordings of the facades that recorded calls with the new calls
+        // merged in, the others are left as they are. Facades without a recording
+        // record all their calls. Calls are recorded on the calling threads and
+        // streaming doesn't apply
+        void start_hybrid()
+        {
             t_lock_guard lg{m_mtx};
-            m_mode = facade_mode::playing;
-            unprotected_load_recordings();
-            m_origin = std::chrono::high_resolution_clock::now();
-            m_pool.start();
-            m_player_thread = std::thread{[this]() { player_thread_main(); }};
+            unprotected_start_playing(facade_mode::hybrid);
         }
 
         void wait_all_pending_callbacks_replayed() const
         {
-            t_unique_lock ulck(m_mtx);
-            while (!m_callbacks.empty() && m_mode == facade_mode::playing) {
-                m_cv.wait(ulck);
-            }
+            t_unique_lock ulck(m_scheduler_mtx);
+            while (!m_callbacks.empty() && m_player_running) m_cv.wait(ulck);
             // when all pending callback entries are removed from the queue or
             // playing has stopped we need to wait until all callback calls
             // that are being processed by the worker pool have completed
             m_pool.wait_completion();
         }
 
+        // must not be called from a facade call or a replayed callback, it waits
+        // for them to complete
         void stop()
         {
-            if (is_passing_through()) return;
-            {
-                t_lock_guard lg{m_mtx};
-                m_pool.stop();
-                if (is_recording()) unprotected_save_recordings();
-                m_mode = facade_mode::passthrough;
-                m_cv.notify_all();  // notfiy that m_player_thread should stop
-            }
-            if (m_player_thread.joinable()) m_player_thread.join();
-            m_cv.notify_all();  // notfiy wait_all_pending_callbacks_replayed
+            t_lock_guard lg{m_mtx};
+            unprotected_stop();
         }
 
         ~master() { stop(); }
@@ -459,5 +1779,10 @@ namespace facade
     };
 
     inline ::facade::master& master() { return ::facade::master::get_instance(); }
+
+    // creates the master during the static initialization, before the first call
+    // of a facade could pay for it
+    inline class ::facade::master& eager_master_instance =
+        ::facade::master::get_instance();
 }  // namespace facade
 #endif
\ No newline at end of file
@@ -0,0 +1,275 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mapped_file.h"
+
+namespace facade
+{
+    // Layout of an indexed recording:
+    //
+    //   [header magic][payload]...[call blob]...[callbacks blob][index][trailer]
+    //
+    // Payloads are the distinct serialized arguments and return values, recorded
+    // calls reference them by id and the index holds their spans. They are written
+    // raw, a loaded recording views them in the mapped file.
+    //
+    // Every recorded function_call is serialized into its own blob so a replaying
+    // facade only has to read the index when the recording is loaded, a call is
+    // decoded from the mapped file the first time it is looked up. The trailer at
+    // the very end of the file points to the index.
+    //
+    // Layout of a streamed recording:
+    //
+    //   [header magic][segment header][segment blob]...
+    //
+    // Segments are appended while recording, each one holds the calls completed
+    // since the previous one. There is no index, the loader finds the segments by
+    // walking their headers and stops at a segment that was not completely written.
+    namespace recording_format
+    {
+        // Bumped whenever an older recording can't be replayed anymore. Version 3
+        // keys recorded calls by hashing argument values instead of their JSON,
+        // version 4 stores every distinct payload once and references it by id
+        constexpr char version = 4;
+        constexpr const char header_magic[8] = {
+            'f', 'a', 'c', 'a', 'd', 'e', 0, version};
+        constexpr const char trailer_magic[8] = {
+            'f', 'a', 'c', 'i', 'd', 'x', 0, version};
+        constexpr const char segment_magic[8] = {
+            'f', 'a', 'c', 's', 'e', 'g', 0, version};
+
+        struct blob_span
+        {
+            uint64_t offset{0};
+            uint64_t size{0};
+
+            template <class t_archive>
+            void serialize(t_archive& archive)
+            {
+                archive(offset, size);
+            }
+        };
+
+        struct index_entry
+        {
+            std::string function_name;
+            uint64_t key{0};
+            blob_span span;
+
+            template <class t_archive>
+            void serialize(t_archive& archive)
+            {
+                archive(function_name, key, span);
+            }
+        };
+
+        struct index
+        {
+            std::string name;
+            // spans of the payloads, the payload with id N is at N - 1
+            std::vector<blob_span> blobs;
+            std::vector<index_entry> calls;
+            blob_span callbacks;
+
+            template <class t_archive>
+            void serialize(t_archive& archive)
+            {
+                archive(name, blobs, calls, callbacks);
+            }
+        };
+
+        struct trailer
+        {
+            blob_span index;
+            char magic[sizeof(trailer_magic)];
+        };
+
+        struct segment_header
+        {
+            char magic[sizeof(segment_magic)];
+            uint64_t size;
+        };
+
+        inline bool has_header(const char* data, size_t size)
+        {
+            return size >= sizeof(header_magic) &&
+                std::memcmp(data, header_magic, sizeof(header_magic)) == 0;
+        }
+
+        // a recording in the binary format of another version
+        inline bool has_other_version(const char* data, size_t size)
+        {
+            return size >= sizeof(header_magic) &&
+                std::memcmp(data, header_magic, sizeof(header_magic) - 1) == 0 &&
+                data[sizeof(header_magic) - 1] != version;
+        }
+
+        inline void write_header(std::ostream& stream)
+        {
+            stream.write(header_magic, sizeof(header_magic));
+        }
+
+        // serializes the value into a segment and writes it with a single write,
+        // returns the number of bytes written
+        template <typename t_archive_policy, typename t_value>
+        size_t write_segment(std::ostream& stream, const t_value& value)
+        {
+            // room for the header is reserved, it's filled in once the size is known
+            segment_header header{};
+            std::ostringstream ss;
+            ss.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            {
+                typename t_archive_policy::t_output_archive archive{ss};
+                archive(value);
+            }
+            std::string segment = ss.str();
+
+            std::memcpy(header.magic, segment_magic, sizeof(segment_magic));
+            header.size = segment.size() - sizeof(header);
+            std::memcpy(segment.data(), &header, sizeof(header));
+
+            stream.write(segment.data(), static_cast<std::streamsize>(segment.size()));
+            stream.flush();
+            return segment.size();
+        }
+
+        // a streamed recording is a header followed by segments, possibly none
+        inline bool is_streamed(const utils::mapped_file& file)
+        {
+            if (!has_header(file.data(), file.size())) return false;
+            if (file.size() == sizeof(header_magic)) return true;
+            return file.size() >= sizeof(header_magic) + sizeof(segment_magic) &&
+                std::memcmp(file.data() + sizeof(header_magic), segment_magic,
+                    sizeof(segment_magic)) == 0;
+        }
+
+        // returns spans of the segment blobs, a segment cut short, i.e. by a crash
+        // of the recording process, and everything after it are left out
+        inline std::vector<blob_span> find_segments(
+            const utils::mapped_file& file, bool& truncated)
+        {
+            std::vector<blob_span> segments;
+            truncated = false;
+            uint64_t offset = sizeof(header_magic);
+            while (offset < file.size()) {
+                segment_header header;
+                if (file.size() - offset < sizeof(header)) {
+                    truncated = true;
+                    break;
+                }
+                std::memcpy(&header, file.data() + offset, sizeof(header));
+                offset += sizeof(header);
+                const bool is_segment =
+                    std::memcmp(header.magic, segment_magic, sizeof(segment_magic)) == 0;
+                if (!is_segment || header.size > file.size() - offset) {
+                    truncated = true;
+                    break;
+                }
+                segments.push_back({offset, header.size});
+                offset += header.size;
+            }
+            return segments;
+        }
+
+        template <typename t_archive_policy>
+        class writer
+        {
+            std::ostream& m_stream;
+            uint64_t m_written{0};
+            std::string m_buffer;
+
+            void write(const char* data, size_t size)
+            {
+                m_stream.write(data, static_cast<std::streamsize>(size));
+                m_written += size;
+            }
+
+        public:
+            explicit writer(std::ostream& stream) : m_stream(stream)
+            {
+                write(header_magic, sizeof(header_magic));
+            }
+
+            blob_span write_raw(std::string_view data)
+            {
+                const blob_span span{m_written, data.size()};
+                write(data.data(), data.size());
+                return span;
+            }
+
+            template <typename t_value>
+            blob_span write_blob(const t_value& value)
+            {
+                std::ostringstream ss;
+                {
+                    typename t_archive_policy::t_output_archive archive{ss};
+                    archive(value);
+                }
+                m_buffer = ss.str();
+                const blob_span span{m_written, m_buffer.size()};
+                write(m_buffer.data(), m_buffer.size());
+                return span;
+            }
+
+            void finish(const index& recording_index)
+            {
+                trailer recording_trailer;
+                recording_trailer.index = write_blob(recording_index);
+                std::memcpy(
+                    recording_trailer.magic, trailer_magic, sizeof(trailer_magic));
+                write(reinterpret_cast<const char*>(&recording_trailer.index),
+                    sizeof(recording_trailer.index));
+                write(recording_trailer.magic, sizeof(recording_trailer.magic));
+                m_stream.flush();
+            }
+        };
+
+        inline void check_span(const utils::mapped_file& file, const blob_span& span)
+        {
+            const uint64_t end = span.offset + span.size;
+            if (end > file.size() || end < span.offset) {
+                throw std::runtime_error{"a recording blob is out of the file bounds"};
+            }
+        }
+
+        template <typename t_archive_policy, typename t_value>
+        void read_blob(
+            const utils::mapped_file& file, const blob_span& span, t_value& value)
+        {
+            check_span(file, span);
+            utils::memory_istream stream{
+                file.data() + span.offset, static_cast<size_t>(span.size)};
+            typename t_archive_policy::t_input_archive archive{stream};
+            archive(value);
+        }
+
+        template <typename t_archive_policy>
+        index read_index(const utils::mapped_file& file)
+        {
+            constexpr size_t trailer_size = sizeof(blob_span) + sizeof(trailer_magic);
+            if (!has_header(file.data(), file.size()) ||
+                file.size() < sizeof(header_magic) + trailer_size) {
+                throw std::runtime_error{"not an indexed recording"};
+            }
+
+            const char* trailer_data = file.data() + file.size() - trailer_size;
+            if (std::memcmp(trailer_data + sizeof(blob_span), trailer_magic,
+                    sizeof(trailer_magic)) != 0) {
+                throw std::runtime_error{"the recording index is missing or truncated"};
+            }
+
+            blob_span index_span;
+            std::memcpy(&index_span, trailer_data, sizeof(index_span));
+            index recording_index;
+            read_blob<t_archive_policy>(file, index_span, recording_index);
+            return recording_index;
+        }
+    }  // namespace recording_format
+}  // namespace facade
@@ -0,0 +1,135 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <stdexcept>
+
+namespace facade
+{
+    // which results of the same call are kept once there are max_results of them
+    enum class result_retention
+    {
+        first,
+        last,
+        // a uniform sample of all the results, kept in the order they were made
+        reservoir
+    };
+
+    // How the calls of a method are recorded. Sampling decides before a call is
+    // made whether it's recorded at all, a call that isn't is passed through to the
+    // implementation. The number of results kept for the same arguments can be
+    // capped on top of it. A default constructed policy records everything
+    struct recording_policy
+    {
+        // records one call in every_nth
+        uint32_t every_nth{1};
+        // probability of recording a call picked by every_nth
+        double probability{1.0};
+        // results kept for the same arguments, 0 keeps all of them
+        size_t max_results{0};
+        result_retention retention{result_retention::first};
+
+        static recording_policy every(uint32_t nth)
+        {
+            recording_policy policy;
+            policy.every_nth = nth;
+            return policy;
+        }
+
+        static recording_policy sampled(double probability)
+        {
+            recording_policy policy;
+            policy.probability = probability;
+            return policy;
+        }
+
+        recording_policy keep_first(size_t results) const
+        {
+            return keep(results, result_retention::first);
+        }
+
+        recording_policy keep_last(size_t results) const
+        {
+            return keep(results, result_retention::last);
+        }
+
+        recording_policy keep_sample(size_t results) const
+        {
+            return keep(results, result_retention::reservoir);
+        }
+
+        recording_policy keep(size_t results, result_retention retained) const
+        {
+            recording_policy policy{*this};
+            policy.max_results = results;
+            policy.retention = retained;
+            return policy;
+        }
+
+        void validate() const
+        {
+            if (every_nth == 0) throw std::invalid_argument{"every_nth can't be 0"};
+            if (!(probability >= 0.0 && probability <= 1.0)) {
+                throw std::invalid_argument{"probability has to be between 0 and 1"};
+            }
+        }
+    };
+
+    // A policy applied to one method of a facade. The call counter is shared by the
+    // threads calling the method, results are only kept or evicted while recorded
+    // calls are merged under the lock of the facade
+    class method_sampler
+    {
+        const recording_policy m_policy;
+        std::atomic<uint64_t> m_calls{0};
+        std::mt19937_64 m_retention_random{std::random_device{}()};
+
+        static double random_fraction()
+        {
+            thread_local std::mt19937_64 random{std::random_device{}()};
+            return std::uniform_real_distribution<double>{0.0, 1.0}(random);
+        }
+
+    public:
+        explicit method_sampler(const recording_policy& policy) : m_policy(policy)
+        {
+            m_policy.validate();
+        }
+
+        const recording_policy& policy() const { return m_policy; }
+
+        bool should_record()
+        {
+            if (m_policy.every_nth > 1) {
+                const uint64_t call = m_calls.fetch_add(1, std::memory_order_relaxed);
+                if (call % m_policy.every_nth != 0) return false;
+            }
+            if (m_policy.probability >= 1.0) return true;
+            return random_fraction() < m_policy.probability;
+        }
+
+        struct retention_decision
+        {
+            bool keep{true};
+            // index of a kept result the new one replaces
+            std::optional<size_t> evict;
+        };
+
+        // decides what happens to a new result of a call that has kept results out
+        // of the seen ones recorded before it
+        retention_decision retain(size_t kept, uint64_t seen)
+        {
+            const size_t max_results = m_policy.max_results;
+            if (max_results == 0 || kept < max_results) return {};
+            if (m_policy.retention == result_retention::first) return {false, {}};
+            if (m_policy.retention == result_retention::last) return {true, size_t{0}};
+            // the new result is kept with probability max_results / (seen + 1)
+            const uint64_t slot =
+                std::uniform_int_distribution<uint64_t>{0, seen}(m_retention_random);
+            if (slot >= kept) return {false, {}};
+            return {true, static_cast<size_t>(slot)};
+        }
+    };
+}  // namespace facade
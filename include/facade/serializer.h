@@ -0,0 +1,183 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace facade
+{
+    namespace utils
+    {
+        // What a recording thread does when the serialization queue is full
+        enum class overflow_policy
+        {
+            block,  // wait until the serializer catches up, no calls are lost
+            drop    // don't record the call and count it as dropped
+        };
+
+        struct serializer_stats
+        {
+            uint64_t enqueued{0};
+            uint64_t processed{0};
+            uint64_t dropped{0};
+            // number of calls that had to wait for room in the queue
+            uint64_t blocked{0};
+            size_t max_queue_depth{0};
+        };
+
+        // Runs jobs handed over by recording threads on a single background thread.
+        // The queue is bounded so a serializer that falls behind either slows the
+        // recording threads down or drops calls, depending on the overflow policy
+        class serializer
+        {
+        public:
+            using t_job = std::function<void()>;
+
+        private:
+            std::deque<t_job> m_queue;
+            size_t m_capacity{65536};
+            overflow_policy m_policy{overflow_policy::block};
+            serializer_stats m_stats;
+            size_t m_in_flight{0};
+            bool m_running{false};
+            std::thread m_thread;
+            mutable std::mutex m_mtx;
+            // notified when there are jobs to run or the serializer is stopping
+            std::condition_variable m_jobs_cv;
+            // notified when jobs have been taken from the queue or completed
+            mutable std::condition_variable m_progress_cv;
+
+            using t_lock_guard = std::lock_guard<decltype(m_mtx)>;
+            using t_unique_lock = std::unique_lock<decltype(m_mtx)>;
+
+            void thread_main()
+            {
+                std::deque<t_job> jobs;
+                t_unique_lock ulck(m_mtx);
+                while (true) {
+                    m_jobs_cv.wait(
+                        ulck, [this]() { return !m_queue.empty() || !m_running; });
+                    // pending jobs are completed before the thread exits
+                    if (m_queue.empty()) return;
+
+                    // take the whole queue at once so recording threads rarely meet
+                    // the serializer on the lock
+                    std::swap(jobs, m_queue);
+                    m_in_flight = jobs.size();
+                    ulck.unlock();
+                    m_progress_cv.notify_all();
+
+                    for (auto& job : jobs) {
+                        try {
+                            job();
+                        } catch (...) {
+                            // a job that can't be serialized is lost, there is no one
+                            // to report it to on this thread
+                        }
+                    }
+                    const auto completed = jobs.size();
+                    jobs.clear();
+
+                    ulck.lock();
+                    m_in_flight = 0;
+                    m_stats.processed += completed;
+                    m_progress_cv.notify_all();
+                }
+            }
+
+        public:
+            void configure(size_t capacity, overflow_policy policy)
+            {
+                t_lock_guard lg(m_mtx);
+                m_capacity = capacity ? capacity : 1;
+                m_policy = policy;
+            }
+
+            void start()
+            {
+                t_lock_guard lg(m_mtx);
+                if (m_running) return;
+                m_running = true;
+                m_stats = serializer_stats{};
+                m_thread = std::thread{[this]() { thread_main(); }};
+            }
+
+            // completes all the pending jobs before stopping
+            void stop()
+            {
+                {
+                    t_lock_guard lg(m_mtx);
+                    if (!m_running) return;
+                    m_running = false;
+                }
+                m_jobs_cv.notify_all();
+                // wakes up recording threads waiting for room in the queue
+                m_progress_cv.notify_all();
+                if (m_thread.joinable()) m_thread.join();
+            }
+
+            // waits until all the jobs submitted so far are completed
+            void drain() const
+            {
+                t_unique_lock ulck(m_mtx);
+                m_progress_cv.wait(
+                    ulck, [this]() { return m_queue.empty() && m_in_flight == 0; });
+            }
+
+            // returns false if the job is dropped, a job submitted while the
+            // serializer is not running is completed on the calling thread
+            bool submit(t_job job)
+            {
+                {
+                    t_unique_lock ulck(m_mtx);
+                    if (m_running) {
+                        if (m_queue.size() >= m_capacity) {
+                            if (m_policy == overflow_policy::drop) {
+                                ++m_stats.dropped;
+                                return false;
+                            }
+                            ++m_stats.blocked;
+                            m_progress_cv.wait(ulck, [this]() {
+                                return m_queue.size() < m_capacity || !m_running;
+                            });
+                        }
+                    }
+
+                    if (m_running) {
+                        m_queue.emplace_back(std::move(job));
+                        ++m_stats.enqueued;
+                        if (m_queue.size() > m_stats.max_queue_depth) {
+                            m_stats.max_queue_depth = m_queue.size();
+                        }
+                        ulck.unlock();
+                        m_jobs_cv.notify_one();
+                        return true;
+                    }
+                }
+
+                job();
+                return true;
+            }
+
+            serializer_stats stats() const
+            {
+                t_lock_guard lg(m_mtx);
+                return m_stats;
+            }
+
+            bool is_running() const
+            {
+                t_lock_guard lg(m_mtx);
+                return m_running;
+            }
+
+            serializer() = default;
+            serializer(const serializer&) = delete;
+            serializer& operator=(const serializer&) = delete;
+
+            ~serializer() { stop(); }
+        };
+    }  // namespace utils
+}  // namespace facade
@@ -0,0 +1,120 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace facade
+{
+    // Counters of the calls of a method made while recording or playing, calls
+    // passed through are not counted. Durations are in nanoseconds
+    template <typename t_counter>
+    struct basic_method_counters
+    {
+        t_counter calls{};
+        // calls sampled out by a recording policy are passed through, not recorded
+        t_counter recorded{};
+        t_counter hits{};
+        // replayed calls without a recording for their arguments, they return
+        // default values
+        t_counter misses{};
+        // arguments and return values serialized by recorded calls
+        t_counter bytes_serialized{};
+        // whole facade calls, the other durations are parts of it
+        t_counter total_ns{};
+        // in the implementation while recording
+        t_counter implementation_ns{};
+        // recorded durations reproduced while replaying
+        t_counter replay_delay_ns{};
+        t_counter hashing_ns{};
+        t_counter serialization_ns{};
+        // decoding recorded results while replaying
+        t_counter decoding_ns{};
+        // waiting for the locks recorded calls are stored under, and for a
+        // streamed recording to be flushed
+        t_counter lock_wait_ns{};
+
+        // calls visitor(name, counters.counter...) for every counter, the counters
+        // can be of any basic_method_counters type
+        template <typename t_visitor, typename... t_counters>
+        static void visit(t_visitor&& visitor, t_counters&... counters)
+        {
+            visitor("calls", counters.calls...);
+            visitor("recorded", counters.recorded...);
+            visitor("hits", counters.hits...);
+            visitor("misses", counters.misses...);
+            visitor("bytes_serialized", counters.bytes_serialized...);
+            visitor("total_ns", counters.total_ns...);
+            visitor("implementation_ns", counters.implementation_ns...);
+            visitor("replay_delay_ns", counters.replay_delay_ns...);
+            visitor("hashing_ns", counters.hashing_ns...);
+            visitor("serialization_ns", counters.serialization_ns...);
+            visitor("decoding_ns", counters.decoding_ns...);
+            visitor("lock_wait_ns", counters.lock_wait_ns...);
+        }
+    };
+
+    // Shared by all the facades with the same name and by all the threads calling
+    // them, every update is a relaxed addition
+    using method_counters = basic_method_counters<std::atomic<uint64_t>>;
+    using t_method_counter = std::atomic<uint64_t> method_counters::*;
+
+    // a snapshot of the counters of a method
+    struct method_stats : basic_method_counters<uint64_t>
+    {
+        std::string facade_name;
+        std::string method_name;
+
+        // time the facade itself added to the calls
+        uint64_t overhead_ns() const
+        {
+            const uint64_t elsewhere = implementation_ns + replay_delay_ns;
+            return total_ns > elsewhere ? total_ns - elsewhere : 0;
+        }
+    };
+
+    // counters are null while stats are not collected
+    inline void add_to_counter(
+        method_counters* counters, t_method_counter counter, uint64_t value = 1)
+    {
+        if (counters) (counters->*counter).fetch_add(value, std::memory_order_relaxed);
+    }
+
+    template <typename t_rep, typename t_period>
+    void add_to_counter(method_counters* counters, t_method_counter counter,
+        const std::chrono::duration<t_rep, t_period>& duration)
+    {
+        const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            duration);
+        add_to_counter(counters, counter, static_cast<uint64_t>(elapsed.count()));
+    }
+
+    // adds the time from its construction to its destruction to a counter
+    class stage_timer
+    {
+        using t_clock = std::chrono::steady_clock;
+
+        std::atomic<uint64_t>* m_counter{nullptr};
+        t_clock::time_point m_started;
+
+    public:
+        stage_timer(method_counters* counters, t_method_counter counter)
+        {
+            if (!counters) return;
+            m_counter = &(counters->*counter);
+            m_started = t_clock::now();
+        }
+
+        stage_timer(const stage_timer&) = delete;
+        stage_timer& operator=(const stage_timer&) = delete;
+
+        ~stage_timer()
+        {
+            if (!m_counter) return;
+            const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                t_clock::now() - m_started);
+            m_counter->fetch_add(
+                static_cast<uint64_t>(elapsed.count()), std::memory_order_relaxed);
+        }
+    };
+}  // namespace facade
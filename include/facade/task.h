@@ -0,0 +1,212 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace facade
+{
+    namespace utils
+    {
+        // Fixed size blocks for callables that don't fit into a task. Freed blocks
+        // are kept on a free list and handed out again, so once the pool has grown
+        // to the number of tasks in flight it doesn't allocate anymore
+        class task_slab
+        {
+        public:
+            static constexpr size_t block_size = 256;
+            static constexpr size_t blocks_per_chunk = 64;
+
+        private:
+            union block
+            {
+                block* next;
+                alignas(std::max_align_t) unsigned char storage[block_size];
+            };
+
+            std::mutex m_mtx;
+            block* m_free{nullptr};
+            std::vector<std::unique_ptr<block[]>> m_chunks;
+
+            using t_lock_guard = std::lock_guard<std::mutex>;
+
+        public:
+            static task_slab& instance()
+            {
+                static task_slab slab;
+                return slab;
+            }
+
+            void* allocate()
+            {
+                t_lock_guard lg(m_mtx);
+                if (!m_free) {
+                    m_chunks.emplace_back(std::make_unique<block[]>(blocks_per_chunk));
+                    for (size_t idx = 0; idx < blocks_per_chunk; ++idx) {
+                        m_chunks.back()[idx].next = m_free;
+                        m_free = &m_chunks.back()[idx];
+                    }
+                }
+                block* allocated = m_free;
+                m_free = allocated->next;
+                return allocated->storage;
+            }
+
+            void deallocate(void* ptr)
+            {
+                auto* freed = static_cast<block*>(ptr);
+                t_lock_guard lg(m_mtx);
+                freed->next = m_free;
+                m_free = freed;
+            }
+        };
+
+        // Move-only type-erased void() callable. Small callables are stored inside
+        // the task, bigger ones in a task_slab block, only callables that don't
+        // fit into a block are allocated on the heap. Unlike std::function it
+        // accepts move-only callables such as std::packaged_task
+        class task
+        {
+        public:
+            static constexpr size_t inline_size = 64;
+
+        private:
+            struct operations
+            {
+                void (*invoke)(void* storage);
+                // move constructs the callable at 'to' and destroys the one at 'from'
+                void (*relocate)(void* from, void* to);
+                void (*destroy)(void* storage);
+            };
+
+            template <typename t_callable>
+            static constexpr bool is_inline = sizeof(t_callable) <= inline_size &&
+                alignof(t_callable) <= alignof(std::max_align_t) &&
+                std::is_nothrow_move_constructible<t_callable>::value;
+
+            template <typename t_callable>
+            static constexpr bool fits_slab_block =
+                sizeof(t_callable) <= task_slab::block_size &&
+                alignof(t_callable) <= alignof(std::max_align_t);
+
+            template <typename t_callable>
+            struct inline_operations
+            {
+                static t_callable& get(void* storage)
+                {
+                    return *std::launder(static_cast<t_callable*>(storage));
+                }
+                static void invoke(void* storage) { get(storage)(); }
+                static void relocate(void* from, void* to)
+                {
+                    new (to) t_callable(std::move(get(from)));
+                    get(from).~t_callable();
+                }
+                static void destroy(void* storage) { get(storage).~t_callable(); }
+                static constexpr operations table{invoke, relocate, destroy};
+            };
+
+            // the storage holds a pointer to the callable
+            template <typename t_callable>
+            struct boxed_operations
+            {
+                static t_callable*& get(void* storage)
+                {
+                    return *std::launder(static_cast<t_callable**>(storage));
+                }
+                static void invoke(void* storage) { (*get(storage))(); }
+                static void relocate(void* from, void* to)
+                {
+                    new (to) t_callable*(get(from));
+                }
+                static void destroy(void* storage)
+                {
+                    t_callable* callable = get(storage);
+                    if constexpr (fits_slab_block<t_callable>) {
+                        callable->~t_callable();
+                        task_slab::instance().deallocate(callable);
+                    } else {
+                        delete callable;
+                    }
+                }
+                static constexpr operations table{invoke, relocate, destroy};
+            };
+
+            alignas(std::max_align_t) unsigned char m_storage[inline_size];
+            const operations* m_operations{nullptr};
+
+            void reset() noexcept
+            {
+                if (m_operations) m_operations->destroy(m_storage);
+                m_operations = nullptr;
+            }
+
+        public:
+            task() = default;
+            task(std::nullptr_t) {}
+
+            template <typename t_function,
+                typename t_callable = typename std::decay<t_function>::type,
+                typename = typename std::enable_if<
+                    !std::is_same<t_callable, task>::value>::type>
+            task(t_function&& function)
+            {
+                if constexpr (is_inline<t_callable>) {
+                    new (m_storage) t_callable(std::forward<t_function>(function));
+                    m_operations = &inline_operations<t_callable>::table;
+                } else {
+                    t_callable* callable;
+                    if constexpr (fits_slab_block<t_callable>) {
+                        auto& slab = task_slab::instance();
+                        void* block = slab.allocate();
+                        try {
+                            callable = new (block)
+                                t_callable(std::forward<t_function>(function));
+                        } catch (...) {
+                            slab.deallocate(block);
+                            throw;
+                        }
+                    } else {
+                        callable = new t_callable(std::forward<t_function>(function));
+                    }
+                    new (m_storage) t_callable*(callable);
+                    m_operations = &boxed_operations<t_callable>::table;
+                }
+            }
+
+            task(task&& that) noexcept : m_operations(that.m_operations)
+            {
+                if (m_operations) m_operations->relocate(that.m_storage, m_storage);
+                that.m_operations = nullptr;
+            }
+
+            task& operator=(task&& that) noexcept
+            {
+                if (this == &that) return *this;
+                reset();
+                m_operations = that.m_operations;
+                if (m_operations) m_operations->relocate(that.m_storage, m_storage);
+                that.m_operations = nullptr;
+                return *this;
+            }
+
+            task& operator=(std::nullptr_t) noexcept
+            {
+                reset();
+                return *this;
+            }
+
+            task(const task&) = delete;
+            task& operator=(const task&) = delete;
+
+            ~task() { reset(); }
+
+            void operator()() { m_operations->invoke(m_storage); }
+
+            explicit operator bool() const { return m_operations != nullptr; }
+        };
+    }  // namespace utils
+}  // namespace facade
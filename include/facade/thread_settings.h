@@ -0,0 +1,124 @@
+#pragma once
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace facade
+{
+    namespace utils
+    {
+        // Placement of a thread started by the library. Everything is optional, a
+        // default constructed instance leaves the thread as the OS created it
+        struct thread_settings
+        {
+            using t_error_cbk = std::function<void(const std::string& msg)>;
+
+            // names are cut to 15 characters on Linux
+            std::string name;
+            // CPUs the thread may run on, any CPU if empty
+            std::vector<size_t> cpus;
+            // a thread of a pool is pinned to a single CPU from cpus, picked by its
+            // index, instead of running on any of them
+            bool one_cpu_per_thread{false};
+            // SCHED_FIFO priority, 0 keeps the default scheduling policy
+            int realtime_priority{0};
+            // nice value of a thread that isn't realtime, 0 keeps the inherited one
+            int nice{0};
+            // called from the thread for every setting that couldn't be applied,
+            // i.e. a realtime priority requires privileges
+            t_error_cbk report_error;
+
+            thread_settings() = default;
+            explicit thread_settings(std::string thread_name)
+                : name(std::move(thread_name))
+            {
+            }
+
+            // settings of the thread with the given index in a pool, its name gets
+            // the index appended
+            thread_settings for_pool_thread(size_t index) const
+            {
+                thread_settings settings{*this};
+                if (!name.empty()) settings.name += std::to_string(index);
+                if (one_cpu_per_thread && !cpus.empty()) {
+                    settings.cpus = {cpus[index % cpus.size()]};
+                }
+                return settings;
+            }
+        };
+
+        // applies the settings to the calling thread
+        inline void apply_thread_settings(const thread_settings& settings)
+        {
+#if defined(__linux__)
+            const auto report = [&settings](const std::string& what, int error) {
+                if (!settings.report_error) return;
+                settings.report_error("failed to set " + what + " of thread '" +
+                    settings.name + "': " + std::strerror(error));
+            };
+
+            const pthread_t self = pthread_self();
+            if (!settings.name.empty()) {
+                const auto name = settings.name.substr(0, 15);
+                if (const int error = pthread_setname_np(self, name.c_str())) {
+                    report("the name", error);
+                }
+            }
+
+            if (!settings.cpus.empty()) {
+                cpu_set_t cpus;
+                CPU_ZERO(&cpus);
+                for (const auto cpu : settings.cpus) {
+                    // a cpu_set_t has room for CPU_SETSIZE CPUs only
+                    if (cpu < CPU_SETSIZE) {
+                        CPU_SET(cpu, &cpus);
+                    } else if (settings.report_error) {
+                        settings.report_error("CPU " + std::to_string(cpu) +
+                            " of thread '" + settings.name + "' is out of range");
+                    }
+                }
+                if (CPU_COUNT(&cpus) == 0) {
+                    report("the CPU affinity", EINVAL);
+                } else if (const int error =
+                               pthread_setaffinity_np(self, sizeof(cpus), &cpus)) {
+                    report("the CPU affinity", error);
+                }
+            }
+
+            if (settings.realtime_priority != 0) {
+                sched_param param{};
+                param.sched_priority = settings.realtime_priority;
+                if (const int error = pthread_setschedparam(self, SCHED_FIFO, &param)) {
+                    report("the realtime priority", error);
+                }
+            } else if (settings.nice != 0) {
+                // on Linux the nice value is a property of the thread
+                const auto tid = static_cast<id_t>(syscall(SYS_gettid));
+                if (setpriority(PRIO_PROCESS, tid, settings.nice) != 0) {
+                    report("the nice value", errno);
+                }
+            }
+#else
+            // naming is cosmetic, it's silently skipped
+            if (!settings.cpus.empty() || settings.realtime_priority != 0 ||
+                settings.nice != 0) {
+                if (settings.report_error) {
+                    settings.report_error(
+                        "thread settings are not supported on this platform");
+                }
+            }
+#endif
+        }
+    }  // namespace utils
+}  // namespace facade
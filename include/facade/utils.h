@@ -1,6 +1,7 @@
 #pragma once
 #include <chrono>
 #include <iostream>
+#include <thread>
 
 namespace facade
 {
@@ -72,13 +73,30 @@ namespace facade
                 std::chrono::high_resolution_clock::now() - origin);
         }
 
+        // The OS scheduler rounds sleeps up, by up to a millisecond or more, so the
+        // last part of a wait is spent spinning to reproduce short durations
+        constexpr t_duration spin_before_deadline{200};
+
+        inline void precise_sleep_until(const t_highres_timepoint& deadline)
+        {
+            using t_clock = std::chrono::high_resolution_clock;
+            const auto remaining = deadline - t_clock::now();
+            if (remaining > spin_before_deadline) {
+                std::this_thread::sleep_for(remaining - spin_before_deadline);
+            }
+            while (t_clock::now() < deadline) std::this_thread::yield();
+        }
+
+        inline void precise_sleep_for(const t_duration& duration)
+        {
+            if (duration <= t_duration::zero()) return;
+            precise_sleep_until(std::chrono::high_resolution_clock::now() + duration);
+        }
+
         inline void sleep_until(
             const t_highres_timepoint& origin, const t_duration& that_offset_form_origin)
         {
-            const auto this_offset = get_offset_from_origin(origin);
-            const auto diff = that_offset_form_origin - this_offset;
-            if (diff < t_duration::zero()) return;
-            std::this_thread::sleep_for(diff);
+            precise_sleep_until(origin + that_offset_form_origin);
         }
 
         template <typename t_visitor>
@@ -1,124 +1,335 @@
 #pragma once
 #include <assert.h>
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
 #include <functional>
 #include <future>
+#include <memory>
 #include <mutex>
-#include <queue>
 #include <thread>
+#include <tuple>
 #include <vector>
 
+#include "task.h"
+#include "thread_settings.h"
+
 namespace facade
 {
     namespace utils
     {
         template <typename t_function, typename... t_args>
         void thread_starter(
-            const size_t thread_id, const t_function& function, t_args... args)
+            const thread_settings& settings, const t_function& function, t_args... args)
         {
-            // add here anything needed for initializing thread context
+            apply_thread_settings(settings);
             function(args...);
         }
 
         template <typename t_function, typename... t_args>
         std::thread make_thread(
-            const size_t thread_id, const t_function& function, t_args... args)
+            const thread_settings& settings, const t_function& function, t_args... args)
         {
             return std::thread{
-                thread_starter<t_function, t_args...>, thread_id, function, args...};
+                thread_starter<t_function, t_args...>, settings, function, args...};
         }
 
+        // Every worker owns a queue of tasks. Tasks submitted from outside of the
+        // pool are spread over the queues round robin, tasks submitted by a worker
+        // go to its own queue. A worker that runs out of tasks steals from the
+        // other queues and keeps searching for a while before going to sleep. A
+        // submitted task wakes up a single sleeping worker, and none if some worker
+        // is still searching. Tasks are taken from the front of a queue, so a pool
+        // with one worker runs them in the order of submission
         class worker_pool
         {
         public:
-            using t_task = std::function<void()>;
+            using t_task = task;
 
         private:
+            // FIFO ring of tasks, the storage only grows so a queue that has seen
+            // its peak load doesn't allocate anymore
+            class task_ring
+            {
+                std::vector<t_task> m_tasks;
+                size_t m_head{0};
+                size_t m_size{0};
+
+                t_task& at(size_t idx)
+                {
+                    return m_tasks[(m_head + idx) % m_tasks.size()];
+                }
+
+            public:
+                bool empty() const { return m_size == 0; }
+                size_t size() const { return m_size; }
+
+                void push_back(t_task&& task)
+                {
+                    if (m_size == m_tasks.size()) {
+                        const size_t capacity = m_tasks.empty() ? 64 : 2 * m_tasks.size();
+                        std::vector<t_task> grown(capacity);
+                        for (size_t idx = 0; idx < m_size; ++idx) {
+                            grown[idx] = std::move(at(idx));
+                        }
+                        m_tasks = std::move(grown);
+                        m_head = 0;
+                    }
+                    at(m_size) = std::move(task);
+                    ++m_size;
+                }
+
+                void pop_front(t_task& task)
+                {
+                    task = std::move(m_tasks[m_head]);
+                    m_head = (m_head + 1) % m_tasks.size();
+                    --m_size;
+                }
+
+                void clear()
+                {
+                    for (size_t idx = 0; idx < m_size; ++idx) at(idx) = nullptr;
+                    m_head = 0;
+                    m_size = 0;
+                }
+            };
+
+            struct task_queue
+            {
+                std::mutex mtx;
+                task_ring tasks;
+            };
+
+            struct worker_state
+            {
+                std::condition_variable cv;
+                bool woken{false};
+            };
+
+            // identifies the pool and the queue of the worker running on this thread
+            struct worker_context
+            {
+                const worker_pool* pool{nullptr};
+                size_t index{0};
+            };
+
             size_t m_workers_num{0};
-            size_t m_current_workload{0};
+            std::vector<std::unique_ptr<task_queue>> m_queues;
+            std::vector<std::unique_ptr<worker_state>> m_states;
             std::vector<std::thread> m_workers;
-            std::queue<t_task> m_task_queue;
-            mutable std::mutex m_queue_mutex;
-            mutable std::condition_variable m_cv;
-            bool m_running{false};
-
-            using t_task_queue = decltype(m_task_queue);
-            using t_lock_guard = std::lock_guard<decltype(m_queue_mutex)>;
-            using t_unique_lock = std::unique_lock<decltype(m_queue_mutex)>;
+            std::atomic<size_t> m_next_queue{0};
+            // tasks in the queues
+            std::atomic<size_t> m_queued{0};
+            // tasks in the queues or being run
+            std::atomic<size_t> m_unfinished{0};
+            std::atomic<size_t> m_sleeping{0};
+            // workers that ran out of tasks and are looking for more before sleeping
+            std::atomic<size_t> m_searching{0};
+            std::atomic_bool m_running{false};
+            thread_settings m_thread_settings;
+
+            // guards the list of sleeping workers
+            std::mutex m_idle_mtx;
+            std::vector<size_t> m_idle;
+
+            // notified when the last unfinished task completes
+            mutable std::mutex m_done_mtx;
+            mutable std::condition_variable m_done_cv;
+
+            using t_lock_guard = std::lock_guard<std::mutex>;
+            using t_unique_lock = std::unique_lock<std::mutex>;
 
         private:
-            std::pair<bool, t_task> get_next_task()
+            static worker_context& this_thread_context()
             {
-                t_task task;
-                {
-                    t_unique_lock ulck(m_queue_mutex);
-                    while (m_task_queue.empty() && m_running) { m_cv.wait(ulck); }
+                thread_local worker_context context;
+                return context;
+            }
+
+            void make_queues()
+            {
+                const size_t queues = m_workers_num ? m_workers_num : 1;
+                m_queues.clear();
+                m_states.clear();
+                for (size_t idx = 0; idx < queues; ++idx) {
+                    m_queues.emplace_back(std::make_unique<task_queue>());
+                    m_states.emplace_back(std::make_unique<worker_state>());
+                }
+            }
+
+            bool pop_task(size_t index, t_task& task)
+            {
+                auto& queue = *m_queues[index];
+                t_lock_guard lg(queue.mtx);
+                if (queue.tasks.empty()) return false;
+                queue.tasks.pop_front(task);
+                m_queued.fetch_sub(1);
+                return true;
+            }
+
+            bool find_task(size_t index, t_task& task)
+            {
+                if (pop_task(index, task)) return true;
+                for (size_t step = 1; step < m_queues.size(); ++step) {
+                    if (pop_task((index + step) % m_queues.size(), task)) return true;
+                }
+                return false;
+            }
+
+            void wake_one(size_t preferred)
+            {
+                // a searching worker picks the task up without being woken
+                if (m_searching.load() != 0 || m_sleeping.load() == 0) return;
+                t_lock_guard lg(m_idle_mtx);
+                if (m_idle.empty()) return;
+
+                auto found = m_idle.end() - 1;
+                for (auto it = m_idle.begin(); it != m_idle.end(); ++it) {
+                    if (*it == preferred) found = it;
+                }
+                auto& state = *m_states[*found];
+                m_idle.erase(found);
+                m_sleeping.fetch_sub(1);
+                state.woken = true;
+                state.cv.notify_one();
+            }
+
+            void wake_all()
+            {
+                t_lock_guard lg(m_idle_mtx);
+                for (const auto index : m_idle) {
+                    m_states[index]->woken = true;
+                    m_states[index]->cv.notify_one();
+                }
+                m_sleeping.fetch_sub(m_idle.size());
+                m_idle.clear();
+            }
 
-                    if (!m_running) return {false, t_task{}};
+            // returns false if the pool is stopping
+            bool sleep(size_t index)
+            {
+                auto& state = *m_states[index];
+                t_unique_lock ulck(m_idle_mtx);
+                // announced before checking for tasks, so a task submitted meanwhile
+                // either is seen here or its submitter sees this worker sleeping
+                m_sleeping.fetch_add(1);
+                if (m_queued.load() != 0 || !m_running) {
+                    m_sleeping.fetch_sub(1);
+                    return m_running;
+                }
+                m_idle.push_back(index);
+                state.woken = false;
+                state.cv.wait(ulck, [&state]() { return state.woken; });
+                return m_running;
+            }
 
-                    task = std::move(m_task_queue.front());
-                    m_task_queue.pop();
-                    m_current_workload++;
+            void complete_task()
+            {
+                if (m_unfinished.fetch_sub(1) == 1) {
+                    t_lock_guard lg(m_done_mtx);
+                    m_done_cv.notify_all();
                 }
+            }
 
-                m_cv.notify_all();
-                return {true, task};
+            // a worker that runs out of tasks keeps looking for a while, waking it up
+            // would cost more than the search when tasks come at a high rate
+            bool search_task(size_t index, t_task& task)
+            {
+                constexpr int search_rounds = 64;
+                m_searching.fetch_add(1);
+                bool found = false;
+                for (int round = 0; round < search_rounds && m_running; ++round) {
+                    if ((found = find_task(index, task))) break;
+                    std::this_thread::yield();
+                }
+                m_searching.fetch_sub(1);
+                // the next searcher or sleeper is in charge of the remaining tasks
+                if (found && m_queued.load() != 0) wake_one(index);
+                return found;
             }
 
-            void worker()
+            void worker(size_t index)
             {
-                while (m_running) {
-                    const auto [continue_execution, performer] = get_next_task();
-                    if (!continue_execution) return;
+                this_thread_context() = {this, index};
+                t_task task;
+                while (true) {
+                    if (!find_task(index, task) && !search_task(index, task)) {
+                        if (!sleep(index)) return;
+                        continue;
+                    }
 
                     try {
-                        performer();
+                        task();
                     } catch (...) {
                         // TODO: decide what do we do in this case
                         // it's either stop or continue
-                        continue;
-                    }
-                    {
-                        t_lock_guard lg(m_queue_mutex);
-                        m_current_workload--;
                     }
-                    m_cv.notify_all();
+                    task = nullptr;
+                    complete_task();
                 }
             }
 
-            bool thread_belongs_to_pool() const
+            void push_task(t_task&& task)
             {
-                const auto this_thread_id = std::this_thread::get_id();
-                for (const auto& thread : m_workers) {
-                    if (this_thread_id == thread.get_id()) return true;
+                auto& context = this_thread_context();
+                // nested tasks stay with the worker that submitted them
+                const size_t index = context.pool == this
+                    ? context.index
+                    : m_next_queue.fetch_add(1) % m_queues.size();
+                // counted before the task is visible in the queue, so the counters
+                // never drop below the number of tasks that are actually there
+                m_unfinished.fetch_add(1);
+                m_queued.fetch_add(1);
+                {
+                    auto& queue = *m_queues[index];
+                    t_lock_guard lg(queue.mtx);
+                    queue.tasks.push_back(std::move(task));
                 }
-
-                return false;
+                wake_one(index);
             }
 
-            auto wait_completion_and_get_lock() const
+            template <typename t_function, typename... t_args>
+            static auto bind_task(t_function&& function, t_args&&... args)
             {
-                t_unique_lock ulck(m_queue_mutex);
-                while (!m_task_queue.empty() && m_running || m_current_workload != 0) {
-                    m_cv.wait(ulck);
+                if constexpr (sizeof...(t_args) == 0) {
+                    return typename std::decay<t_function>::type{
+                        std::forward<t_function>(function)};
+                } else {
+                    return [function = std::forward<t_function>(function),
+                               args = std::make_tuple(std::forward<t_args>(args)...)](
+                               ) mutable { return std::apply(function, args); };
                 }
-                return std::move(ulck);
+            }
+
+            bool thread_belongs_to_pool() const
+            {
+                return this_thread_context().pool == this;
             }
 
         public:
-            void wait_completion() const { wait_completion_and_get_lock(); }
+            // waits until all the submitted tasks have completed, it must not be
+            // called from a worker of this pool
+            void wait_completion() const
+            {
+                assert(!thread_belongs_to_pool());
+                t_unique_lock ulck(m_done_mtx);
+                m_done_cv.wait(
+                    ulck, [this]() { return !m_running || m_unfinished.load() == 0; });
+            }
 
             void stop()
             {
-                {
-                    const auto lock = wait_completion_and_get_lock();
-                    m_running = false;
-                    m_cv.notify_all();
-                }
+                if (!m_running) return;
+                wait_completion();
+                m_running = false;
+                wake_all();
                 for (auto& thread : m_workers) { thread.join(); }
-                m_current_workload = 0;
                 m_workers.clear();
+                {
+                    // wakes up those waiting for completion of a stopped pool
+                    t_lock_guard lg(m_done_mtx);
+                    m_done_cv.notify_all();
+                }
             }
 
             void start()
@@ -127,49 +338,47 @@ namespace facade
 
                 m_running = true;
                 for (size_t idx = 0; idx < m_workers_num; ++idx) {
-                    const auto binder = [this]() { worker(); };
-                    m_workers.emplace_back(make_thread(idx, binder));
+                    const auto binder = [this, idx]() { worker(idx); };
+                    m_workers.emplace_back(
+                        make_thread(m_thread_settings.for_pool_thread(idx), binder));
                 }
             }
 
+            // workers can submit tasks to their own pool, such a task is queued
+            // to the submitting worker and can be stolen by the idle ones
             template <typename t_function, typename... t_args>
             auto submit(t_function&& function, t_args&&... args)
             {
-                t_lock_guard lg(m_queue_mutex);
-
-                if (thread_belongs_to_pool()) {
-                    assert(
-                        "worker threads can not submit tasks to the same pool \
-                    cause this may lead to dead locks");
-                    return std::future<decltype(function(args...))>{};
-                }
-
-                auto deferred_call = std::bind(
-                    std::forward<t_function>(function), std::forward<t_args>(args)...);
-
-                auto deferred_task =
-                    std::make_shared<std::packaged_task<decltype(function(args...))()>>(
-                        std::move(deferred_call));
-
-                // Wrap packaged task into void function
-                const std::function<void()> task_performer = [deferred_task]() {
-                    (*deferred_task)();
-                };
-
-                m_task_queue.push(task_performer);
+                std::packaged_task<decltype(function(args...))()> deferred_task{
+                    bind_task(std::forward<t_function>(function),
+                        std::forward<t_args>(args)...)};
+                auto future = deferred_task.get_future();
+                push_task(t_task{std::move(deferred_task)});
+                return future;
+            }
 
-                m_cv.notify_one();
-                return deferred_task->get_future();
+            // like submit but there is no way to get the result or to find out when
+            // the task is completed, in exchange a task whose callable fits into
+            // t_task doesn't allocate
+            template <typename t_function, typename... t_args>
+            void post(t_function&& function, t_args&&... args)
+            {
+                push_task(t_task{bind_task(
+                    std::forward<t_function>(function), std::forward<t_args>(args)...)});
             }
 
-            bool is_running() const { return m_running; }
-            bool has_work() const
+            // takes effect on the next start
+            void set_thread_settings(thread_settings settings)
             {
-                t_lock_guard lg(m_queue_mutex);
-                return !m_task_queue.empty() || m_current_workload != 0;
+                m_thread_settings = std::move(settings);
             }
 
-            worker_pool(size_t workers) : m_workers_num(workers) {}
+            bool is_running() const { return m_running; }
+            bool has_work() const { return m_unfinished.load() != 0; }
+            // tasks submitted and not taken by a worker yet
+            size_t queued() const { return m_queued.load(); }
+
+            worker_pool(size_t workers) : m_workers_num(workers) { make_queues(); }
 
             ~worker_pool() { stop(); }
 
@@ -181,7 +390,15 @@ namespace facade
                 rhv.stop();
 
                 m_workers_num = rhv.m_workers_num;
-                m_task_queue = std::move(rhv.m_task_queue);
+                m_thread_settings = rhv.m_thread_settings;
+                make_queues();
+                t_task task;
+                for (size_t idx = 0; idx < rhv.m_queues.size(); ++idx) {
+                    while (rhv.pop_task(idx, task)) {
+                        rhv.m_unfinished.fetch_sub(1);
+                        push_task(std::move(task));
+                    }
+                }
                 return *this;
             }
 
@@ -194,10 +411,13 @@ namespace facade
                     // worker_pool is not running, the worker_pool will be stopped
                     stop();
                 }
-                t_lock_guard lg(m_queue_mutex);
-                t_task_queue empty;
-                std::swap(m_task_queue, empty);
+                for (auto& queue : m_queues) {
+                    t_lock_guard lg(queue->mtx);
+                    m_queued.fetch_sub(queue->tasks.size());
+                    m_unfinished.fetch_sub(queue->tasks.size());
+                    queue->tasks.clear();
+                }
             }
         };
     }  // namespace utils
-}  // namespace facade
\ No newline at end of file
+}  // namespace facade